@@ -0,0 +1,294 @@
+// Regression suite over a deterministic synthetic corpus (see corpus_generator.h): AddDocument,
+// RemoveDocument seq/par, FindTopDocuments seq/par with and without a predicate, MatchDocument
+// seq/par, ProcessQueries and RemoveDuplicates. Every benchmark prints one JSON object per line
+// with throughput, latency percentiles in microseconds and the peak resident memory so far;
+// the first line describes the corpus. Options, all optional:
+//   --documents=N --document-length=N --vocabulary=N --zipf=S --stop-words=N --stop-word-ratio=R
+//   --queries=N --query-length=N --minus-word-ratio=R --duplicate-ratio=R --seed=N
+//   --filter=TEXT runs only the benchmarks whose name contains TEXT
+//   --metrics=PATH writes the query metrics in Prometheus text format to PATH at the end
+//
+// Build from the search-server folder:
+//   g++ -std=c++17 -O2 -I. benchmark/benchmark_suite.cpp process_queries.cpp remove_duplicates.cpp search_server.cpp
+//       document.cpp string_processing.cpp term_dictionary.cpp posting_list.cpp snapshot.cpp query_cache.cpp
+//       index_segment.cpp thread_pool.cpp metrics.cpp -ltbb -lpthread -o benchmark_suite
+
+#include "corpus_generator.h"
+#include "process_queries.h"
+#include "remove_duplicates.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    using Clock = chrono::steady_clock;
+
+    const size_t PROCESS_QUERIES_REPEAT_COUNT = 5;
+    // every REMOVED_DOCUMENT_STEP-th document is removed
+    const size_t REMOVED_DOCUMENT_STEP = 10;
+
+    string filter;
+    string metrics_path;
+
+    double GetPeakMemoryMegabytes()
+    {
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss / 1024.0;
+    }
+
+    double GetMicroseconds(Clock::time_point start)
+    {
+        return chrono::duration<double, micro>(Clock::now() - start).count();
+    }
+
+    bool IsSelected(string_view name)
+    {
+        return name.find(filter) != string_view::npos;
+    }
+
+    // latencies are of single calls, operation_count may be larger when a call does several
+    void Report(string_view name, vector<double> latencies, double total_microseconds, size_t operation_count)
+    {
+        sort(latencies.begin(), latencies.end());
+        const auto percentile = [&latencies](double share)
+        {
+            return latencies[min(latencies.size() - 1, static_cast<size_t>(share * latencies.size()))];
+        };
+        double mean = 0.0;
+        for (const double latency : latencies)
+        {
+            mean += latency / latencies.size();
+        }
+        cout << fixed << setprecision(3) << "{\"benchmark\": \""s << name << "\", \"operations\": "s << operation_count
+             << ", \"throughput_per_second\": "s << operation_count / (total_microseconds / 1e6)
+             << ", \"mean_us\": "s << mean << ", \"p50_us\": "s << percentile(0.5) << ", \"p90_us\": "s << percentile(0.9)
+             << ", \"p99_us\": "s << percentile(0.99) << ", \"max_us\": "s << latencies.back()
+             << ", \"peak_rss_mb\": "s << GetPeakMemoryMegabytes() << "}"s << endl;
+    }
+
+    // times function(i) for every i in [0, count)
+    template <typename Function>
+    void Run(string_view name, size_t count, Function function)
+    {
+        if (!IsSelected(name) || count == 0)
+        {
+            return;
+        }
+        vector<double> latencies;
+        latencies.reserve(count);
+        const auto start = Clock::now();
+        for (size_t i = 0; i < count; ++i)
+        {
+            const auto call_start = Clock::now();
+            function(i);
+            latencies.push_back(GetMicroseconds(call_start));
+        }
+        Report(name, move(latencies), GetMicroseconds(start), count);
+    }
+
+    SearchServer MakeServer(const Corpus &corpus)
+    {
+        SearchServer search_server(corpus.stop_words);
+        for (size_t i = 0; i < corpus.documents.size(); ++i)
+        {
+            search_server.AddDocument(static_cast<int>(i), corpus.documents[i], DocumentStatus::ACTUAL, {static_cast<int>(i % 10)});
+        }
+        return search_server;
+    }
+
+    CorpusOptions ParseOptions(int argc, char *argv[])
+    {
+        CorpusOptions options;
+        for (int i = 1; i < argc; ++i)
+        {
+            const string_view argument = argv[i];
+            const size_t equals = argument.find('=');
+            if (argument.substr(0, 2) != "--"sv || equals == string_view::npos)
+            {
+                throw invalid_argument("Expected --name=value, got "s + string(argument));
+            }
+            const string_view name = argument.substr(2, equals - 2);
+            const string value(argument.substr(equals + 1));
+            if (name == "documents"sv)
+            {
+                options.document_count = stoul(value);
+            }
+            else if (name == "document-length"sv)
+            {
+                options.document_length = stoul(value);
+            }
+            else if (name == "vocabulary"sv)
+            {
+                options.vocabulary_size = stoul(value);
+            }
+            else if (name == "zipf"sv)
+            {
+                options.zipf_exponent = stod(value);
+            }
+            else if (name == "stop-words"sv)
+            {
+                options.stop_word_count = stoul(value);
+            }
+            else if (name == "stop-word-ratio"sv)
+            {
+                options.stop_word_ratio = stod(value);
+            }
+            else if (name == "queries"sv)
+            {
+                options.query_count = stoul(value);
+            }
+            else if (name == "query-length"sv)
+            {
+                options.query_length = stoul(value);
+            }
+            else if (name == "minus-word-ratio"sv)
+            {
+                options.minus_word_ratio = stod(value);
+            }
+            else if (name == "duplicate-ratio"sv)
+            {
+                options.duplicate_ratio = stod(value);
+            }
+            else if (name == "seed"sv)
+            {
+                options.seed = stoull(value);
+            }
+            else if (name == "filter"sv)
+            {
+                filter = value;
+            }
+            else if (name == "metrics"sv)
+            {
+                metrics_path = value;
+            }
+            else
+            {
+                throw invalid_argument("Unknown option "s + string(name));
+            }
+        }
+        return options;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    CorpusOptions options;
+    try
+    {
+        options = ParseOptions(argc, argv);
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    const Corpus corpus = CorpusGenerator(options).Generate();
+    const size_t document_count = corpus.documents.size();
+    const size_t query_count = corpus.queries.size();
+    cout << "{\"benchmark\": \"corpus\", \"documents\": "s << document_count << ", \"document_length\": "s << options.document_length
+         << ", \"vocabulary\": "s << options.vocabulary_size << ", \"zipf\": "s << options.zipf_exponent
+         << ", \"stop_words\": "s << options.stop_word_count << ", \"stop_word_ratio\": "s << options.stop_word_ratio
+         << ", \"queries\": "s << query_count << ", \"query_length\": "s << options.query_length
+         << ", \"minus_word_ratio\": "s << options.minus_word_ratio << ", \"duplicate_ratio\": "s << options.duplicate_ratio
+         << ", \"seed\": "s << options.seed << ", \"hardware_threads\": "s << thread::hardware_concurrency() << "}"s << endl;
+
+    // the index built here serves every read benchmark
+    SearchServer search_server(corpus.stop_words);
+    const auto add_document = [&](size_t i)
+    {
+        search_server.AddDocument(static_cast<int>(i), corpus.documents[i], DocumentStatus::ACTUAL, {static_cast<int>(i % 10)});
+    };
+    if (IsSelected("add_document"sv))
+    {
+        Run("add_document"sv, document_count, add_document);
+    }
+    else
+    {
+        for (size_t i = 0; i < document_count; ++i)
+        {
+            add_document(i);
+        }
+    }
+
+    const auto is_even = [](int document_id, DocumentStatus, int)
+    {
+        return document_id % 2 == 0;
+    };
+    Run("find_top_documents/seq"sv, query_count, [&](size_t i)
+        { search_server.FindTopDocuments(execution::seq, corpus.queries[i]); });
+    Run("find_top_documents/par"sv, query_count, [&](size_t i)
+        { search_server.FindTopDocuments(execution::par, corpus.queries[i]); });
+    Run("find_top_documents/seq/predicate"sv, query_count, [&](size_t i)
+        { search_server.FindTopDocuments(execution::seq, corpus.queries[i], is_even); });
+    Run("find_top_documents/par/predicate"sv, query_count, [&](size_t i)
+        { search_server.FindTopDocuments(execution::par, corpus.queries[i], is_even); });
+
+    // each query against a document spread over the whole index
+    const auto get_matched_id = [document_count](size_t i)
+    {
+        return static_cast<int>(i * 7919 % document_count);
+    };
+    Run("match_document/seq"sv, document_count > 0 ? query_count : 0, [&](size_t i)
+        { search_server.MatchDocument(execution::seq, corpus.queries[i], get_matched_id(i)); });
+    Run("match_document/par"sv, document_count > 0 ? query_count : 0, [&](size_t i)
+        { search_server.MatchDocument(execution::par, corpus.queries[i], get_matched_id(i)); });
+
+    if (IsSelected("process_queries"sv) && query_count > 0)
+    {
+        vector<double> latencies;
+        const auto start = Clock::now();
+        for (size_t i = 0; i < PROCESS_QUERIES_REPEAT_COUNT; ++i)
+        {
+            const auto call_start = Clock::now();
+            ProcessQueries(search_server, corpus.queries);
+            latencies.push_back(GetMicroseconds(call_start));
+        }
+        Report("process_queries"sv, move(latencies), GetMicroseconds(start), PROCESS_QUERIES_REPEAT_COUNT * query_count);
+    }
+
+    // removal changes the index, so every run gets a fresh copy
+    const size_t removed_count = (document_count + REMOVED_DOCUMENT_STEP - 1) / REMOVED_DOCUMENT_STEP;
+    if (IsSelected("remove_document/seq"sv))
+    {
+        SearchServer removal_server = MakeServer(corpus);
+        Run("remove_document/seq"sv, removed_count, [&](size_t i)
+            { removal_server.RemoveDocument(execution::seq, static_cast<int>(i * REMOVED_DOCUMENT_STEP)); });
+    }
+    if (IsSelected("remove_document/par"sv))
+    {
+        SearchServer removal_server = MakeServer(corpus);
+        Run("remove_document/par"sv, removed_count, [&](size_t i)
+            { removal_server.RemoveDocument(execution::par, static_cast<int>(i * REMOVED_DOCUMENT_STEP)); });
+    }
+    if (IsSelected("remove_duplicates"sv) && document_count > 0)
+    {
+        SearchServer removal_server = MakeServer(corpus);
+        // the removed ids are printed, keep them out of the report
+        ostringstream found;
+        streambuf *const output = cout.rdbuf(found.rdbuf());
+        const auto start = Clock::now();
+        RemoveDuplicates(removal_server);
+        const double time = GetMicroseconds(start);
+        cout.rdbuf(output);
+        Report("remove_duplicates"sv, {time}, time, document_count);
+    }
+
+    if (!metrics_path.empty())
+    {
+        WriteMetrics(metrics_path);
+    }
+}
@@ -0,0 +1,137 @@
+// Memory and removal latency under churn. A window of documents slides over a stream in
+// which every document brings a word of its own, as ids and typos do: each step removes the
+// oldest document and adds a new one. Per phase of the stream the benchmark reports
+// RemoveDocument latency and the memory the index owns; automatic compaction keeps it
+// bounded, max latency includes it. At the end the index is compacted on demand and the
+// memory before and after is printed, with a check that queries return the same results.
+// Half a window before the end, with removed documents in the index, it also goes through a
+// snapshot, and the reloaded server has to match exactly the documents left.
+//
+// Build from the search-server folder:
+//   g++ -std=c++17 -O2 -I. benchmark/compaction_benchmark.cpp search_server.cpp document.cpp string_processing.cpp
+//       term_dictionary.cpp posting_list.cpp snapshot.cpp query_cache.cpp index_segment.cpp thread_pool.cpp metrics.cpp
+//       -ltbb -lpthread -o compaction_benchmark
+
+#include "search_server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    const int WINDOW_SIZE = 50000;
+    const int STEP_COUNT = 200000;
+    const int PHASE_COUNT = 8;
+
+    string MakeText(int document_id, mt19937 &generator)
+    {
+        string text = "id"s + to_string(document_id);
+        for (int i = 0; i < 20; ++i)
+        {
+            text += " w"s + to_string(generator() % 5000);
+        }
+        return text;
+    }
+
+    double ToMegabytes(size_t bytes)
+    {
+        return bytes / 1024.0 / 1024.0;
+    }
+
+    bool IsSameAfterReload(const SearchServer &search_server)
+    {
+        const string snapshot_path = "compaction_benchmark.snapshot"s;
+        search_server.SaveSnapshot(snapshot_path);
+        SearchServer loaded_server(""s);
+        loaded_server.LoadSnapshot(snapshot_path);
+        remove(snapshot_path.c_str());
+        vector<int> matched_ids;
+        loaded_server.MatchAllDocuments(execution::seq, "w1"s, [&matched_ids](int document_id, const vector<string_view> &, DocumentStatus)
+                                        { matched_ids.push_back(document_id); });
+        sort(matched_ids.begin(), matched_ids.end());
+        return equal(matched_ids.begin(), matched_ids.end(), search_server.begin(), search_server.end());
+    }
+}
+
+int main()
+{
+    mt19937 generator(42);
+    SearchServer search_server(""s);
+    search_server.SetAutoCompaction(true);
+    for (int id = 0; id < WINDOW_SIZE; ++id)
+    {
+        search_server.AddDocument(id, MakeText(id, generator), DocumentStatus::ACTUAL, {1});
+    }
+
+    cout << "window: "s << WINDOW_SIZE << " documents, steps: "s << STEP_COUNT << endl;
+    cout << fixed << setprecision(2);
+    cout << "steps      remove mean, us   p99, us    max, us   memory, MB"s << endl;
+    vector<double> latencies;
+    const int phase_size = STEP_COUNT / PHASE_COUNT;
+    bool is_reload_exact = true;
+    for (int step = 0; step < STEP_COUNT; ++step)
+    {
+        const auto start = chrono::steady_clock::now();
+        search_server.RemoveDocument(step);
+        latencies.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+        search_server.AddDocument(WINDOW_SIZE + step, MakeText(WINDOW_SIZE + step, generator), DocumentStatus::ACTUAL, {1});
+        if (step + 1 == STEP_COUNT - WINDOW_SIZE / 2)
+        {
+            is_reload_exact = IsSameAfterReload(search_server);
+        }
+
+        if ((step + 1) % phase_size == 0)
+        {
+            double mean = 0.0;
+            for (const double latency : latencies)
+            {
+                mean += latency / latencies.size();
+            }
+            sort(latencies.begin(), latencies.end());
+            cout << setw(6) << step + 1 << setw(20) << mean << setw(10) << latencies[latencies.size() * 99 / 100]
+                 << setw(11) << latencies.back() << setw(13) << ToMegabytes(search_server.GetMemoryUsage()) << endl;
+            latencies.clear();
+        }
+    }
+
+    vector<string> queries;
+    for (int i = 0; i < 100; ++i)
+    {
+        queries.push_back("w"s + to_string(i) + " w"s + to_string(i * 37 % 5000) + " id"s + to_string(STEP_COUNT + i * 11) + " -w"s + to_string(i % 7));
+    }
+    vector<vector<Document>> results;
+    for (const string &query : queries)
+    {
+        results.push_back(search_server.FindTopDocuments(query));
+    }
+
+    const size_t memory_before = search_server.GetMemoryUsage();
+    const auto start = chrono::steady_clock::now();
+    search_server.Compact();
+    const double compaction_time = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    const size_t memory_after = search_server.GetMemoryUsage();
+    cout << "Compact(): "s << ToMegabytes(memory_before) << " MB -> "s << ToMegabytes(memory_after) << " MB in "s
+         << compaction_time << " ms"s << endl;
+
+    int mismatch_count = 0;
+    for (size_t i = 0; i < queries.size(); ++i)
+    {
+        const auto documents = search_server.FindTopDocuments(queries[i]);
+        const bool is_same = equal(documents.begin(), documents.end(), results[i].begin(), results[i].end(),
+                                   [](const Document &lhs, const Document &rhs)
+                                   { return lhs.id == rhs.id && abs(lhs.relevance - rhs.relevance) < 1e-9; });
+        mismatch_count += is_same ? 0 : 1;
+    }
+    cout << "queries changed by compaction: "s << mismatch_count << endl;
+    cout << "documents after a snapshot reload: "s << (is_reload_exact ? "same"s : "differ"s) << endl;
+    return mismatch_count == 0 && is_reload_exact ? 0 : 1;
+}
@@ -0,0 +1,208 @@
+// Stress test and latency comparison for queries running while the index changes. Reader
+// threads query a sliding window of documents that one writer keeps moving: it adds the
+// next id and removes the oldest one. Three setups are measured: readers alone, readers
+// with the writer through ConcurrentSearchServer, and readers with the writer behind the
+// global shared_mutex that was needed before. Every pinned version is checked to hold a
+// whole window of ids, a torn read makes the program fail.
+//
+// Build from the search-server folder:
+//   g++ -std=c++17 -O2 -I. benchmark/concurrent_updates_benchmark.cpp concurrent_search_server.cpp search_server.cpp
+//       document.cpp string_processing.cpp term_dictionary.cpp posting_list.cpp snapshot.cpp query_cache.cpp index_segment.cpp thread_pool.cpp metrics.cpp
+//       -ltbb -lpthread -o concurrent_updates_benchmark
+
+#include "concurrent_search_server.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    const int WINDOW_SIZE = 20000;
+    const int READER_COUNT = 3;
+    const auto PHASE_DURATION = chrono::seconds(2);
+
+    string MakeText(int document_id)
+    {
+        // a shared word, a few common ones and one unique to the document
+        static const vector<string> common_words = {"cat"s, "dog"s, "bird"s, "fish"s, "tail"s, "eyes"s, "hat"s, "collar"s};
+        string text = "pet "s;
+        for (int i = 0; i < 6; ++i)
+        {
+            text += common_words[(document_id * 7 + i * 3) % common_words.size()] + " "s;
+        }
+        return text + "x"s + to_string(document_id);
+    }
+
+    struct LatencyStats
+    {
+        size_t query_count = 0;
+        double p50 = 0.0;
+        double p99 = 0.0;
+        double max = 0.0;
+    };
+
+    LatencyStats Summarize(vector<double> latencies)
+    {
+        LatencyStats stats;
+        stats.query_count = latencies.size();
+        if (latencies.empty())
+        {
+            return stats;
+        }
+        sort(latencies.begin(), latencies.end());
+        stats.p50 = latencies[latencies.size() / 2];
+        stats.p99 = latencies[latencies.size() * 99 / 100];
+        stats.max = latencies.back();
+        return stats;
+    }
+
+    // true when the version holds exactly the ids first..last and finds the newest one by its word
+    bool IsConsistent(const SearchServer &search_server)
+    {
+        if (search_server.GetDocumentCount() == 0)
+        {
+            return false;
+        }
+        const int first = *search_server.begin();
+        const int last = *prev(search_server.end());
+        if (last - first + 1 != search_server.GetDocumentCount())
+        {
+            return false;
+        }
+        const auto documents = search_server.FindTopDocuments("x"s + to_string(last));
+        return documents.size() == 1 && documents[0].id == last;
+    }
+
+    // runs the readers for one phase while write() is called in a loop, if given
+    template <typename Read, typename Write>
+    LatencyStats RunPhase(Read read, Write write, bool with_writer, atomic<uint64_t> &write_count, atomic<uint64_t> &error_count)
+    {
+        atomic<bool> is_running = true;
+        vector<vector<double>> latencies(READER_COUNT);
+        vector<thread> threads;
+        for (int reader = 0; reader < READER_COUNT; ++reader)
+        {
+            threads.emplace_back([&, reader]()
+                                 {
+                                     static const vector<string> queries = {"cat dog"s, "bird -fish"s, "pet tail"s, "collar hat -cat"s, "eyes"s};
+                                     mt19937 generator(reader);
+                                     while (is_running)
+                                     {
+                                         const string &query = queries[generator() % queries.size()];
+                                         const auto start = chrono::steady_clock::now();
+                                         if (!read(query))
+                                         {
+                                             ++error_count;
+                                         }
+                                         latencies[reader].push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+                                     } });
+        }
+        if (with_writer)
+        {
+            threads.emplace_back([&]()
+                                 {
+                                     while (is_running)
+                                     {
+                                         write();
+                                         ++write_count;
+                                     } });
+        }
+        this_thread::sleep_for(PHASE_DURATION);
+        is_running = false;
+        for (thread &thread : threads)
+        {
+            thread.join();
+        }
+        vector<double> all_latencies;
+        for (const auto &reader_latencies : latencies)
+        {
+            all_latencies.insert(all_latencies.end(), reader_latencies.begin(), reader_latencies.end());
+        }
+        return Summarize(move(all_latencies));
+    }
+
+    void PrintRow(const string &name, const LatencyStats &stats, uint64_t write_count)
+    {
+        cout << name << setw(10) << stats.query_count << setw(10) << stats.p50 << setw(10) << stats.p99
+             << setw(12) << stats.max << setw(10) << write_count << endl;
+    }
+}
+
+int main()
+{
+    vector<string> texts;
+    vector<NewDocument> documents;
+    for (int id = 0; id < WINDOW_SIZE; ++id)
+    {
+        texts.push_back(MakeText(id));
+    }
+    for (int id = 0; id < WINDOW_SIZE; ++id)
+    {
+        documents.push_back({id, texts[id], DocumentStatus::ACTUAL, {id % 10}});
+    }
+
+    ConcurrentSearchServer concurrent_server(""s);
+    concurrent_server.AddDocuments(execution::par, documents);
+    SearchServer locked_server(""s);
+    locked_server.AddDocuments(execution::par, documents);
+    shared_mutex index_mutex;
+
+    atomic<uint64_t> error_count = 0;
+    int next_id = WINDOW_SIZE;
+    const auto read_concurrent = [&](const string &query)
+    {
+        const auto search_server = concurrent_server.Pin();
+        search_server->FindTopDocuments(query);
+        return IsConsistent(*search_server);
+    };
+    const auto write_concurrent = [&]()
+    {
+        concurrent_server.AddDocument(next_id, MakeText(next_id), DocumentStatus::ACTUAL, {1});
+        // the window moves in two published steps, readers must only ever see whole ones
+        concurrent_server.RemoveDocument(next_id - WINDOW_SIZE);
+        ++next_id;
+    };
+    const auto read_locked = [&](const string &query)
+    {
+        shared_lock lock(index_mutex);
+        locked_server.FindTopDocuments(query);
+        return IsConsistent(locked_server);
+    };
+    const auto write_locked = [&]()
+    {
+        unique_lock lock(index_mutex);
+        locked_server.AddDocument(next_id, MakeText(next_id), DocumentStatus::ACTUAL, {1});
+        locked_server.RemoveDocument(next_id - WINDOW_SIZE);
+        ++next_id;
+    };
+
+    atomic<uint64_t> idle_writes = 0;
+    const LatencyStats idle = RunPhase(read_concurrent, write_concurrent, false, idle_writes, error_count);
+    atomic<uint64_t> concurrent_writes = 0;
+    const LatencyStats concurrent = RunPhase(read_concurrent, write_concurrent, true, concurrent_writes, error_count);
+    next_id = WINDOW_SIZE;
+    atomic<uint64_t> locked_writes = 0;
+    const LatencyStats locked = RunPhase(read_locked, write_locked, true, locked_writes, error_count);
+
+    cout << "documents: "s << WINDOW_SIZE << ", readers: "s << READER_COUNT << ", hardware threads: "s << thread::hardware_concurrency() << endl;
+    cout << fixed << setprecision(1);
+    cout << "setup                        queries   p50, us   p99, us   max, us   updates"s << endl;
+    PrintRow("readers only                "s, idle, idle_writes);
+    PrintRow("ConcurrentSearchServer      "s, concurrent, concurrent_writes);
+    PrintRow("global shared_mutex         "s, locked, locked_writes);
+    cout << "inconsistent reads: "s << error_count << endl;
+    return error_count == 0 ? 0 : 1;
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+// Deterministic synthetic corpus and queries for benchmarks. Words are drawn from a vocabulary
+// with Zipf-distributed frequencies, like words of natural text. Draws do not use the standard
+// distributions, whose output differs between standard libraries, so a seed gives the same corpus
+// everywhere.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct CorpusOptions
+{
+    std::size_t document_count = 50000;
+    std::size_t document_length = 50;
+    std::size_t vocabulary_size = 50000;
+    // exponent of the Zipf law, the word of rank r has weight 1 / r^s
+    double zipf_exponent = 1.0;
+    std::size_t stop_word_count = 20;
+    // share of stop words in documents and queries
+    double stop_word_ratio = 0.1;
+    std::size_t query_count = 2000;
+    std::size_t query_length = 3;
+    // share of query words that are minus words
+    double minus_word_ratio = 0.1;
+    // share of documents that repeat an earlier one with the words shuffled
+    double duplicate_ratio = 0.05;
+    std::uint64_t seed = 42;
+};
+
+struct Corpus
+{
+    std::vector<std::string> stop_words;
+    std::vector<std::string> documents;
+    std::vector<std::string> queries;
+};
+
+class CorpusGenerator
+{
+public:
+    explicit CorpusGenerator(const CorpusOptions &options)
+        : options_(options), generator_(options.seed)
+    {
+        if (options.vocabulary_size == 0 || options.document_length == 0 || options.query_length == 0)
+        {
+            throw std::invalid_argument("Corpus needs words, documents and queries of at least one word");
+        }
+        double weight_sum = 0.0;
+        for (std::size_t rank = 1; rank <= options.vocabulary_size; ++rank)
+        {
+            weight_sum += 1.0 / std::pow(static_cast<double>(rank), options.zipf_exponent);
+            cumulative_weights_.push_back(weight_sum);
+        }
+    }
+
+    Corpus Generate()
+    {
+        Corpus corpus;
+        for (std::size_t i = 0; i < options_.stop_word_count; ++i)
+        {
+            // capitals, so they never clash with the vocabulary
+            corpus.stop_words.push_back("S" + MakeWord(i));
+        }
+        std::vector<std::vector<std::string>> document_words;
+        for (std::size_t i = 0; i < options_.document_count; ++i)
+        {
+            if (i > 0 && DrawUniform() < options_.duplicate_ratio)
+            {
+                std::vector<std::string> words = document_words[DrawIndex(i)];
+                for (std::size_t j = words.size(); j > 1; --j)
+                {
+                    std::swap(words[j - 1], words[DrawIndex(j)]);
+                }
+                document_words.push_back(std::move(words));
+            }
+            else
+            {
+                std::vector<std::string> words;
+                for (std::size_t j = 0; j < options_.document_length; ++j)
+                {
+                    words.push_back(DrawWord(corpus.stop_words));
+                }
+                document_words.push_back(std::move(words));
+            }
+            corpus.documents.push_back(Join(document_words.back()));
+        }
+        for (std::size_t i = 0; i < options_.query_count; ++i)
+        {
+            std::vector<std::string> words;
+            for (std::size_t j = 0; j < options_.query_length; ++j)
+            {
+                std::string word = DrawWord(corpus.stop_words);
+                words.push_back(DrawUniform() < options_.minus_word_ratio ? "-" + word : word);
+            }
+            corpus.queries.push_back(Join(words));
+        }
+        return corpus;
+    }
+
+private:
+    CorpusOptions options_;
+    std::mt19937_64 generator_;
+    std::vector<double> cumulative_weights_;
+
+    // in [0, 1), from the top 53 bits
+    double DrawUniform()
+    {
+        return (generator_() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    std::size_t DrawIndex(std::size_t count)
+    {
+        return static_cast<std::size_t>(DrawUniform() * count);
+    }
+
+    std::string DrawWord(const std::vector<std::string> &stop_words)
+    {
+        if (!stop_words.empty() && DrawUniform() < options_.stop_word_ratio)
+        {
+            return stop_words[DrawIndex(stop_words.size())];
+        }
+        const double weight = DrawUniform() * cumulative_weights_.back();
+        const auto it = std::upper_bound(cumulative_weights_.begin(), cumulative_weights_.end(), weight);
+        const std::size_t rank = std::min<std::size_t>(it - cumulative_weights_.begin(), cumulative_weights_.size() - 1);
+        return MakeWord(rank);
+    }
+
+    // letters only, frequent words are the short ones as in natural text
+    static std::string MakeWord(std::size_t rank)
+    {
+        std::string word;
+        do
+        {
+            word.push_back(static_cast<char>('a' + rank % 26));
+            rank /= 26;
+        } while (rank > 0);
+        return word;
+    }
+
+    static std::string Join(const std::vector<std::string> &words)
+    {
+        std::string text;
+        for (const std::string &word : words)
+        {
+            if (!text.empty())
+            {
+                text.push_back(' ');
+            }
+            text += word;
+        }
+        return text;
+    }
+};
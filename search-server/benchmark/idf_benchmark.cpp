@@ -0,0 +1,165 @@
+// Measures what long queries spend on inverse document frequencies: the former way,
+// a std::map lookup of the word's postings plus log(N / df) for every plus word, against
+// the maintained table, log(N) - log(df) read per term. The full query latency of the
+// server is printed for scale.
+//
+// Build from the search-server folder:
+//   g++ -std=c++17 -O2 -I. benchmark/idf_benchmark.cpp search_server.cpp document.cpp string_processing.cpp
+//       term_dictionary.cpp posting_list.cpp snapshot.cpp query_cache.cpp index_segment.cpp thread_pool.cpp metrics.cpp
+//       -ltbb -o idf_benchmark
+
+#include "search_server.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    struct Corpus
+    {
+        vector<string> texts;
+        map<string, size_t, less<>> document_freqs;
+        vector<string> queries;
+        vector<vector<string>> query_words;
+    };
+
+    Corpus GenerateCorpus(uint32_t document_count, uint32_t vocabulary_size, uint32_t words_per_document,
+                          uint32_t query_count, uint32_t words_per_query)
+    {
+        mt19937 generator(42);
+        // Zipf(1) over the vocabulary through the inverse of its cumulative weights
+        vector<double> cumulative(vocabulary_size);
+        double sum = 0.0;
+        for (uint32_t rank = 0; rank < vocabulary_size; ++rank)
+        {
+            sum += 1.0 / (rank + 1);
+            cumulative[rank] = sum;
+        }
+        uniform_real_distribution<double> uniform(0.0, sum);
+        const auto next_word = [&]()
+        {
+            return "w"s + to_string(lower_bound(cumulative.begin(), cumulative.end(), uniform(generator)) - cumulative.begin());
+        };
+
+        Corpus corpus;
+        for (uint32_t document = 0; document < document_count; ++document)
+        {
+            string text;
+            set<string> words;
+            for (uint32_t i = 0; i < words_per_document; ++i)
+            {
+                const string word = next_word();
+                text += word + " "s;
+                words.insert(word);
+            }
+            for (const string &word : words)
+            {
+                ++corpus.document_freqs[word];
+            }
+            corpus.texts.push_back(move(text));
+        }
+        // long queries of mostly rare words, where scoring is cheap and per-term overhead shows
+        uniform_int_distribution<uint32_t> rare_rank(vocabulary_size / 10, vocabulary_size - 1);
+        for (uint32_t i = 0; i < query_count; ++i)
+        {
+            string query;
+            vector<string> words;
+            for (uint32_t j = 0; j < words_per_query; ++j)
+            {
+                words.push_back("w"s + to_string(rare_rank(generator)));
+                query += words.back() + " "s;
+            }
+            corpus.queries.push_back(move(query));
+            corpus.query_words.push_back(move(words));
+        }
+        return corpus;
+    }
+
+    template <typename Function>
+    double MeasureMicroseconds(size_t query_count, Function run_query)
+    {
+        double checksum = 0.0;
+        const auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < query_count; ++i)
+        {
+            checksum += run_query(i);
+        }
+        const auto elapsed = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+        if (checksum == 0.0)
+        {
+            cerr << "empty checksum"s << endl;
+        }
+        return elapsed / query_count;
+    }
+}
+
+int main()
+{
+    const Corpus corpus = GenerateCorpus(100000, 200000, 50, 2000, 200);
+    vector<NewDocument> documents;
+    for (size_t i = 0; i < corpus.texts.size(); ++i)
+    {
+        documents.push_back({static_cast<int>(i), corpus.texts[i], DocumentStatus::ACTUAL, {1}});
+    }
+    SearchServer search_server(""s);
+    search_server.AddDocuments(execution::par, documents);
+    const size_t query_count = corpus.queries.size();
+    const double document_count = static_cast<double>(corpus.texts.size());
+
+    // the table the server keeps: log(df) per word and log(N) once
+    map<string_view, double> log_document_freqs;
+    for (const auto &[word, document_freq] : corpus.document_freqs)
+    {
+        log_document_freqs.emplace(word, log(document_freq));
+    }
+    vector<vector<double>> query_log_document_freqs;
+    for (const auto &words : corpus.query_words)
+    {
+        auto &logs = query_log_document_freqs.emplace_back();
+        for (const string &word : words)
+        {
+            const auto it = log_document_freqs.find(word);
+            logs.push_back(it == log_document_freqs.end() ? 0.0 : it->second);
+        }
+    }
+    const double log_document_count = log(document_count);
+
+    const double recomputed_latency = MeasureMicroseconds(query_count, [&](size_t i)
+                                                          {
+                                                              double idf_sum = 0.0;
+                                                              for (const string &word : corpus.query_words[i])
+                                                              {
+                                                                  const auto it = corpus.document_freqs.find(word);
+                                                                  if (it != corpus.document_freqs.end())
+                                                                  {
+                                                                      idf_sum += log(document_count / it->second);
+                                                                  }
+                                                              }
+                                                              return idf_sum; });
+    const double table_latency = MeasureMicroseconds(query_count, [&](size_t i)
+                                                     {
+                                                         double idf_sum = 0.0;
+                                                         for (const double log_document_freq : query_log_document_freqs[i])
+                                                         {
+                                                             idf_sum += log_document_count - log_document_freq;
+                                                         }
+                                                         return idf_sum; });
+    const double query_latency = MeasureMicroseconds(query_count, [&](size_t i)
+                                                     { return static_cast<double>(search_server.FindTopDocuments(corpus.queries[i]).size()); });
+
+    cout << "documents: "s << corpus.texts.size() << ", words per query: "s << corpus.query_words[0].size() << endl;
+    cout << fixed << setprecision(2);
+    cout << "idf per query, map lookup + log(N / df), us  "s << recomputed_latency << endl;
+    cout << "idf per query, maintained table, us          "s << table_latency << endl;
+    cout << "full query with the table, us                "s << query_latency << endl;
+}
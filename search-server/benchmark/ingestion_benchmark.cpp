@@ -0,0 +1,145 @@
+// AddDocument latency as the corpus grows. Documents are added one by one and latencies
+// are reported per window of the corpus: mean, p99 and max, with the number of segments
+// the server holds at the end of the window. For comparison the same postings are appended
+// to one posting list per term in a single vector, the layout used before segments, whose
+// growth with the vocabulary copies every list. Query latency over the final index is
+// printed at the end.
+//
+// Build from the search-server folder:
+//   g++ -std=c++17 -O2 -I. benchmark/ingestion_benchmark.cpp search_server.cpp document.cpp string_processing.cpp
+//       term_dictionary.cpp posting_list.cpp snapshot.cpp query_cache.cpp index_segment.cpp thread_pool.cpp metrics.cpp
+//       -ltbb -lpthread -o ingestion_benchmark
+
+#include "search_server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    const uint32_t DOCUMENT_COUNT = 400000;
+    const uint32_t WINDOW_COUNT = 8;
+    const uint32_t WORDS_PER_DOCUMENT = 40;
+
+    struct Corpus
+    {
+        vector<string> texts;
+        vector<map<uint32_t, uint32_t>> term_counts;
+        vector<string> queries;
+    };
+
+    // Zipf(1) words over a vocabulary that keeps growing, as new names and typos do
+    Corpus GenerateCorpus()
+    {
+        mt19937 generator(42);
+        const uint32_t vocabulary_size = 1000000;
+        vector<double> cumulative(vocabulary_size);
+        double sum = 0.0;
+        for (uint32_t rank = 0; rank < vocabulary_size; ++rank)
+        {
+            sum += 1.0 / (rank + 1);
+            cumulative[rank] = sum;
+        }
+        uniform_real_distribution<double> uniform(0.0, sum);
+        Corpus corpus;
+        for (uint32_t document = 0; document < DOCUMENT_COUNT; ++document)
+        {
+            string text;
+            map<uint32_t, uint32_t> term_counts;
+            for (uint32_t i = 0; i < WORDS_PER_DOCUMENT; ++i)
+            {
+                const auto term = static_cast<uint32_t>(lower_bound(cumulative.begin(), cumulative.end(), uniform(generator)) - cumulative.begin());
+                text += "w"s + to_string(term) + " "s;
+                ++term_counts[term];
+            }
+            corpus.texts.push_back(move(text));
+            corpus.term_counts.push_back(move(term_counts));
+        }
+        for (uint32_t i = 0; i < 200; ++i)
+        {
+            corpus.queries.push_back("w"s + to_string(i % 50) + " w"s + to_string(100 + i) + " w"s + to_string(1000 + i * 7) + " -w"s + to_string(3 + i % 5));
+        }
+        return corpus;
+    }
+
+    struct WindowStats
+    {
+        double mean = 0.0;
+        double p99 = 0.0;
+        double max = 0.0;
+    };
+
+    WindowStats Summarize(vector<double> &latencies)
+    {
+        WindowStats stats;
+        for (const double latency : latencies)
+        {
+            stats.mean += latency / latencies.size();
+        }
+        sort(latencies.begin(), latencies.end());
+        stats.p99 = latencies[latencies.size() * 99 / 100];
+        stats.max = latencies.back();
+        latencies.clear();
+        return stats;
+    }
+}
+
+int main()
+{
+    const Corpus corpus = GenerateCorpus();
+    const uint32_t window_size = DOCUMENT_COUNT / WINDOW_COUNT;
+
+    SearchServer search_server(""s);
+    vector<PostingList> single_vector_postings;
+    vector<double> segment_latencies;
+    vector<double> single_vector_latencies;
+
+    cout << "documents: "s << DOCUMENT_COUNT << ", words per document: "s << WORDS_PER_DOCUMENT << endl;
+    cout << fixed << setprecision(2);
+    cout << "corpus size   segments: mean, us  p99, us   max, us   | one vector per term: mean, us  p99, us   max, us"s << endl;
+    for (uint32_t document = 0; document < DOCUMENT_COUNT; ++document)
+    {
+        auto start = chrono::steady_clock::now();
+        search_server.AddDocument(static_cast<int>(document), corpus.texts[document], DocumentStatus::ACTUAL, {1});
+        segment_latencies.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+
+        start = chrono::steady_clock::now();
+        for (const auto [term, term_count] : corpus.term_counts[document])
+        {
+            if (term >= single_vector_postings.size())
+            {
+                single_vector_postings.resize(term + 1);
+            }
+            single_vector_postings[term].Append(document, term_count);
+        }
+        single_vector_latencies.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+
+        if ((document + 1) % window_size == 0)
+        {
+            const WindowStats segments = Summarize(segment_latencies);
+            const WindowStats single_vector = Summarize(single_vector_latencies);
+            cout << setw(11) << document + 1 << setw(21) << segments.mean << setw(9) << segments.p99 << setw(10) << segments.max
+                 << "   (" << setw(3) << search_server.GetSegmentCount() << ")"s
+                 << setw(26) << single_vector.mean << setw(9) << single_vector.p99 << setw(10) << single_vector.max << endl;
+        }
+    }
+
+    double checksum = 0.0;
+    const auto start = chrono::steady_clock::now();
+    for (const string &query : corpus.queries)
+    {
+        checksum += search_server.FindTopDocuments(query).size();
+    }
+    const double query_latency = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / corpus.queries.size();
+    cout << "query latency over "s << search_server.GetSegmentCount() << " segments, us: "s << query_latency
+         << (checksum > 0.0 ? ""s : " (no results)"s) << endl;
+}
@@ -0,0 +1,86 @@
+// Matching one query against every document three ways: the former MatchDocuments loop, which
+// advanced a set iterator from begin() to each index and called MatchDocument, MatchDocument
+// called while iterating the ids once, and MatchAllDocuments walking the posting lists, one
+// by one and under std::execution::par. Every way must report the same number of matched words.
+//
+// Build from the search-server folder:
+//   g++ -std=c++17 -O2 -I. benchmark/match_documents_benchmark.cpp search_server.cpp document.cpp string_processing.cpp
+//       term_dictionary.cpp posting_list.cpp snapshot.cpp query_cache.cpp index_segment.cpp thread_pool.cpp metrics.cpp
+//       -ltbb -lpthread -o match_documents_benchmark
+
+#include "search_server.h"
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    const int DOCUMENT_COUNT = 30000;
+    const string QUERY = "w1 w2 w3 w5 w8 w13 w21 w34 -w55"s;
+
+    template <typename Function>
+    void Measure(const string &name, Function function)
+    {
+        const auto start = chrono::steady_clock::now();
+        const size_t word_count = function();
+        cout << name << setw(10) << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count()
+             << setw(14) << word_count << endl;
+    }
+}
+
+int main()
+{
+    mt19937 generator(42);
+    SearchServer search_server(""s);
+    for (int id = 0; id < DOCUMENT_COUNT; ++id)
+    {
+        string text;
+        for (int i = 0; i < 20; ++i)
+        {
+            text += "w"s + to_string(generator() % 100) + " "s;
+        }
+        search_server.AddDocument(id, text, DocumentStatus::ACTUAL, {1});
+    }
+
+    cout << "documents: "s << DOCUMENT_COUNT << ", query: "s << QUERY << endl;
+    cout << fixed << setprecision(1);
+    cout << "pass                          time, ms   matched words"s << endl;
+    Measure("advance from begin()        "s, [&]()
+            {
+                size_t word_count = 0;
+                for (int index = 0; index < search_server.GetDocumentCount(); ++index)
+                {
+                    auto it = search_server.begin();
+                    advance(it, index);
+                    word_count += get<0>(search_server.MatchDocument(QUERY, *it)).size();
+                }
+                return word_count; });
+    Measure("MatchDocument per id        "s, [&]()
+            {
+                size_t word_count = 0;
+                for (const int id : search_server)
+                {
+                    word_count += get<0>(search_server.MatchDocument(QUERY, id)).size();
+                }
+                return word_count; });
+    Measure("MatchAllDocuments, seq      "s, [&]()
+            {
+                size_t word_count = 0;
+                search_server.MatchAllDocuments(execution::seq, QUERY, [&word_count](int, const vector<string_view> &words, DocumentStatus)
+                                                { word_count += words.size(); });
+                return word_count; });
+    Measure("MatchAllDocuments, par      "s, [&]()
+            {
+                atomic<size_t> word_count = 0;
+                search_server.MatchAllDocuments(execution::par, QUERY, [&word_count](int, const vector<string_view> &words, DocumentStatus)
+                                                { word_count += words.size(); });
+                return word_count.load(); });
+}
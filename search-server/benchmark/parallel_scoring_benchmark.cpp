@@ -0,0 +1,194 @@
+// Compares exhaustive scoring engines on one corpus: the sequential dense accumulator,
+// the lock-free parallel engine that splits the index into document ranges, and the
+// previous parallel engine that sent every posting through a ConcurrentMap.
+//
+// Build from the search-server folder:
+//   g++ -std=c++17 -O2 -I. benchmark/parallel_scoring_benchmark.cpp search_server.cpp document.cpp string_processing.cpp
+//       term_dictionary.cpp posting_list.cpp snapshot.cpp query_cache.cpp index_segment.cpp thread_pool.cpp metrics.cpp
+//       -ltbb -o parallel_scoring_benchmark
+
+#include "concurrent_map.h"
+#include "search_server.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    struct Corpus
+    {
+        vector<string> texts;
+        vector<vector<uint32_t>> document_terms;
+        vector<string> queries;
+        vector<vector<uint32_t>> query_plus_terms;
+        vector<vector<uint32_t>> query_minus_terms;
+    };
+
+    Corpus GenerateCorpus(uint32_t document_count, uint32_t vocabulary_size, uint32_t words_per_document, uint32_t query_count)
+    {
+        mt19937 generator(42);
+        // Zipf(1) over the vocabulary through the inverse of its cumulative weights
+        vector<double> cumulative(vocabulary_size);
+        double sum = 0.0;
+        for (uint32_t rank = 0; rank < vocabulary_size; ++rank)
+        {
+            sum += 1.0 / (rank + 1);
+            cumulative[rank] = sum;
+        }
+        uniform_real_distribution<double> uniform(0.0, sum);
+        const auto next_term = [&]()
+        {
+            return static_cast<uint32_t>(lower_bound(cumulative.begin(), cumulative.end(), uniform(generator)) - cumulative.begin());
+        };
+        const auto word = [](uint32_t term)
+        {
+            return "w"s + to_string(term);
+        };
+
+        Corpus corpus;
+        for (uint32_t document = 0; document < document_count; ++document)
+        {
+            string text;
+            vector<uint32_t> terms;
+            for (uint32_t i = 0; i < words_per_document; ++i)
+            {
+                terms.push_back(next_term());
+                text += word(terms.back()) + " "s;
+            }
+            corpus.texts.push_back(move(text));
+            corpus.document_terms.push_back(move(terms));
+        }
+        for (uint32_t i = 0; i < query_count; ++i)
+        {
+            const vector<uint32_t> plus_terms = {next_term(), next_term(), next_term(), next_term()};
+            const uint32_t minus_term = next_term() + vocabulary_size / 10;
+            corpus.queries.push_back(word(plus_terms[0]) + " "s + word(plus_terms[1]) + " "s + word(plus_terms[2]) + " "s +
+                                     word(plus_terms[3]) + " -"s + word(minus_term));
+            corpus.query_plus_terms.push_back(plus_terms);
+            corpus.query_minus_terms.push_back({minus_term});
+        }
+        return corpus;
+    }
+
+    // the parallel engine as it was before: one locked std::map insert per posting
+    class ConcurrentMapEngine
+    {
+    public:
+        explicit ConcurrentMapEngine(const Corpus &corpus)
+        {
+            for (uint32_t document = 0; document < corpus.document_terms.size(); ++document)
+            {
+                map<uint32_t, uint32_t> term_counts;
+                for (const uint32_t term : corpus.document_terms[document])
+                {
+                    ++term_counts[term];
+                }
+                for (const auto [term, term_count] : term_counts)
+                {
+                    if (term >= postings_.size())
+                    {
+                        postings_.resize(term + 1);
+                    }
+                    postings_[term].Append(document, term_count);
+                }
+                inv_word_counts_.push_back(1.0 / corpus.document_terms[document].size());
+            }
+        }
+
+        vector<Document> FindTopDocuments(const vector<uint32_t> &plus_terms, const vector<uint32_t> &minus_terms) const
+        {
+            ConcurrentMap<uint32_t, double> document_to_relevance(100);
+            for_each(execution::par, plus_terms.begin(), plus_terms.end(), [&](uint32_t term)
+                     {
+                         const PostingList &postings = GetPostings(term);
+                         if (postings.empty())
+                         {
+                             return;
+                         }
+                         const double inverse_document_freq = log(inv_word_counts_.size() * 1.0 / postings.size());
+                         postings.ForEach([&](uint32_t document, uint32_t term_count)
+                                          { document_to_relevance[document].ref_to_value += term_count * inv_word_counts_[document] * inverse_document_freq; }); });
+            for_each(execution::par, minus_terms.begin(), minus_terms.end(), [&](uint32_t term)
+                     { GetPostings(term).ForEach([&](uint32_t document, uint32_t)
+                                                 { document_to_relevance.erase(document); }); });
+            vector<TopDocumentsCollector> bucket_top_documents(document_to_relevance.GetBucketCount(), TopDocumentsCollector(MAX_RESULT_DOCUMENT_COUNT));
+            document_to_relevance.ForEachBucket(execution::par, [&](size_t bucket, const map<uint32_t, double> &relevances)
+                                                {
+                                                    for (const auto [document, relevance] : relevances)
+                                                    {
+                                                        bucket_top_documents[bucket].Add({static_cast<int>(document), relevance, 0});
+                                                    } });
+            TopDocumentsCollector top_documents(MAX_RESULT_DOCUMENT_COUNT);
+            for (const auto &bucket_top : bucket_top_documents)
+            {
+                top_documents.Merge(bucket_top);
+            }
+            return top_documents.Extract();
+        }
+
+    private:
+        vector<PostingList> postings_;
+        vector<double> inv_word_counts_;
+        PostingList empty_postings_;
+
+        const PostingList &GetPostings(uint32_t term) const
+        {
+            return term < postings_.size() ? postings_[term] : empty_postings_;
+        }
+    };
+
+    template <typename Function>
+    double MeasureMicroseconds(size_t query_count, Function find_top_documents)
+    {
+        size_t checksum = 0;
+        const auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < query_count; ++i)
+        {
+            checksum += find_top_documents(i).size();
+        }
+        const auto elapsed = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+        if (checksum == 0)
+        {
+            cerr << "no results"s << endl;
+        }
+        return elapsed / query_count;
+    }
+}
+
+int main()
+{
+    const Corpus corpus = GenerateCorpus(200000, 50000, 60, 200);
+    vector<NewDocument> documents;
+    for (size_t i = 0; i < corpus.texts.size(); ++i)
+    {
+        documents.push_back({static_cast<int>(i), corpus.texts[i], DocumentStatus::ACTUAL, {static_cast<int>(i % 10)}});
+    }
+    SearchServer search_server(""s);
+    search_server.AddDocuments(execution::par, documents);
+    search_server.SetQueryEvaluation(QueryEvaluation::EXHAUSTIVE);
+    const ConcurrentMapEngine concurrent_map_engine(corpus);
+    const size_t query_count = corpus.queries.size();
+
+    const double seq_latency = MeasureMicroseconds(query_count, [&](size_t i)
+                                                   { return search_server.FindTopDocuments(execution::seq, corpus.queries[i]); });
+    const double par_latency = MeasureMicroseconds(query_count, [&](size_t i)
+                                                   { return search_server.FindTopDocuments(execution::par, corpus.queries[i]); });
+    const double concurrent_map_latency = MeasureMicroseconds(query_count, [&](size_t i)
+                                                              { return concurrent_map_engine.FindTopDocuments(corpus.query_plus_terms[i], corpus.query_minus_terms[i]); });
+
+    cout << "documents: "s << corpus.texts.size() << ", hardware threads: "s << thread::hardware_concurrency() << endl;
+    cout << fixed << setprecision(1);
+    cout << "engine                      query latency, us"s << endl;
+    cout << "seq dense accumulator       "s << seq_latency << endl;
+    cout << "par document ranges         "s << par_latency << endl;
+    cout << "par ConcurrentMap (before)  "s << concurrent_map_latency << endl;
+}
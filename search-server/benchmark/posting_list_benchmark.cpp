@@ -0,0 +1,212 @@
+// Compares posting list layouts: the original std::map<int, double> per word,
+// a flat vector of (document index, term_freq) and the compressed PostingList.
+//
+// Build from the search-server folder:
+//   g++ -std=c++17 -O2 -I. benchmark/posting_list_benchmark.cpp posting_list.cpp snapshot.cpp -o posting_list_benchmark
+
+#include "posting_list.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    size_t allocated_bytes = 0;
+
+    template <typename T>
+    struct CountingAllocator
+    {
+        using value_type = T;
+
+        CountingAllocator() = default;
+
+        template <typename U>
+        CountingAllocator(const CountingAllocator<U> &)
+        {
+        }
+
+        T *allocate(size_t count)
+        {
+            allocated_bytes += count * sizeof(T);
+            return allocator<T>().allocate(count);
+        }
+
+        void deallocate(T *pointer, size_t count)
+        {
+            allocated_bytes -= count * sizeof(T);
+            allocator<T>().deallocate(pointer, count);
+        }
+
+        template <typename U>
+        bool operator==(const CountingAllocator<U> &) const
+        {
+            return true;
+        }
+
+        template <typename U>
+        bool operator!=(const CountingAllocator<U> &) const
+        {
+            return false;
+        }
+    };
+
+    struct FlatPosting
+    {
+        uint32_t document_index;
+        double term_freq;
+    };
+
+    using MapPostings = map<int, double, less<int>, CountingAllocator<pair<const int, double>>>;
+    using FlatPostings = vector<FlatPosting, CountingAllocator<FlatPosting>>;
+
+    struct Corpus
+    {
+        vector<vector<uint32_t>> term_documents;
+        vector<vector<uint32_t>> term_counts;
+        vector<double> inv_word_counts;
+        vector<vector<uint32_t>> queries;
+    };
+
+    Corpus GenerateCorpus(uint32_t document_count, uint32_t vocabulary_size, uint32_t words_per_document, uint32_t query_count)
+    {
+        mt19937 generator(42);
+        // Zipf(1) over the vocabulary through the inverse of its cumulative weights
+        vector<double> cumulative(vocabulary_size);
+        double sum = 0.0;
+        for (uint32_t rank = 0; rank < vocabulary_size; ++rank)
+        {
+            sum += 1.0 / (rank + 1);
+            cumulative[rank] = sum;
+        }
+        uniform_real_distribution<double> uniform(0.0, sum);
+        const auto next_term = [&]()
+        {
+            return static_cast<uint32_t>(lower_bound(cumulative.begin(), cumulative.end(), uniform(generator)) - cumulative.begin());
+        };
+
+        Corpus corpus;
+        corpus.term_documents.resize(vocabulary_size);
+        corpus.term_counts.resize(vocabulary_size);
+        for (uint32_t document = 0; document < document_count; ++document)
+        {
+            map<uint32_t, uint32_t> counts;
+            for (uint32_t i = 0; i < words_per_document; ++i)
+            {
+                ++counts[next_term()];
+            }
+            for (const auto [term, count] : counts)
+            {
+                corpus.term_documents[term].push_back(document);
+                corpus.term_counts[term].push_back(count);
+            }
+            corpus.inv_word_counts.push_back(1.0 / words_per_document);
+        }
+        for (uint32_t i = 0; i < query_count; ++i)
+        {
+            corpus.queries.push_back({next_term(), next_term(), next_term(), next_term()});
+        }
+        return corpus;
+    }
+
+    template <typename Function>
+    double MeasureMicroseconds(const Corpus &corpus, Function score_query)
+    {
+        vector<double> relevance(corpus.inv_word_counts.size());
+        const auto start = chrono::steady_clock::now();
+        double checksum = 0.0;
+        for (const auto &query : corpus.queries)
+        {
+            fill(relevance.begin(), relevance.end(), 0.0);
+            for (const uint32_t term : query)
+            {
+                const double inverse_document_freq = log(corpus.inv_word_counts.size() * 1.0 / max<size_t>(1, corpus.term_documents[term].size()));
+                score_query(term, inverse_document_freq, relevance);
+            }
+            checksum += relevance[query[0] % relevance.size()];
+        }
+        const auto elapsed = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+        if (checksum < 0)
+        {
+            cerr << checksum;
+        }
+        return elapsed / corpus.queries.size();
+    }
+}
+
+int main()
+{
+    const Corpus corpus = GenerateCorpus(100000, 50000, 100, 500);
+    size_t posting_count = 0;
+    for (const auto &documents : corpus.term_documents)
+    {
+        posting_count += documents.size();
+    }
+
+    allocated_bytes = 0;
+    vector<MapPostings> map_index(corpus.term_documents.size());
+    for (size_t term = 0; term < corpus.term_documents.size(); ++term)
+    {
+        for (size_t i = 0; i < corpus.term_documents[term].size(); ++i)
+        {
+            const uint32_t document = corpus.term_documents[term][i];
+            map_index[term].emplace(document, corpus.term_counts[term][i] * corpus.inv_word_counts[document]);
+        }
+    }
+    const size_t map_bytes = allocated_bytes;
+
+    allocated_bytes = 0;
+    vector<FlatPostings> flat_index(corpus.term_documents.size());
+    for (size_t term = 0; term < corpus.term_documents.size(); ++term)
+    {
+        flat_index[term].reserve(corpus.term_documents[term].size());
+        for (size_t i = 0; i < corpus.term_documents[term].size(); ++i)
+        {
+            const uint32_t document = corpus.term_documents[term][i];
+            flat_index[term].push_back({document, corpus.term_counts[term][i] * corpus.inv_word_counts[document]});
+        }
+    }
+    const size_t flat_bytes = allocated_bytes;
+
+    vector<PostingList> compressed_index(corpus.term_documents.size());
+    size_t compressed_bytes = 0;
+    for (size_t term = 0; term < corpus.term_documents.size(); ++term)
+    {
+        for (size_t i = 0; i < corpus.term_documents[term].size(); ++i)
+        {
+            compressed_index[term].Append(corpus.term_documents[term][i], corpus.term_counts[term][i]);
+        }
+        compressed_bytes += compressed_index[term].GetMemoryUsage() - sizeof(PostingList);
+    }
+
+    const double map_latency = MeasureMicroseconds(corpus, [&](uint32_t term, double inverse_document_freq, vector<double> &relevance)
+                                                   {
+                                                       for (const auto [document, term_freq] : map_index[term])
+                                                       {
+                                                           relevance[document] += term_freq * inverse_document_freq;
+                                                       } });
+    const double flat_latency = MeasureMicroseconds(corpus, [&](uint32_t term, double inverse_document_freq, vector<double> &relevance)
+                                                    {
+                                                        for (const auto [document, term_freq] : flat_index[term])
+                                                        {
+                                                            relevance[document] += term_freq * inverse_document_freq;
+                                                        } });
+    const double compressed_latency = MeasureMicroseconds(corpus, [&](uint32_t term, double inverse_document_freq, vector<double> &relevance)
+                                                          { compressed_index[term].ForEach([&](uint32_t document, uint32_t term_count)
+                                                                                           { relevance[document] += term_count * corpus.inv_word_counts[document] * inverse_document_freq; }); });
+
+    cout << "postings: "s << posting_count << endl;
+    cout << fixed << setprecision(2);
+    cout << "layout       bytes/posting  query latency, us"s << endl;
+    cout << "std::map     "s << setw(13) << map_bytes * 1.0 / posting_count << "  "s << map_latency << endl;
+    cout << "flat vector  "s << setw(13) << flat_bytes * 1.0 / posting_count << "  "s << flat_latency << endl;
+    cout << "compressed   "s << setw(13) << compressed_bytes * 1.0 / posting_count << "  "s << compressed_latency << endl;
+}
@@ -0,0 +1,123 @@
+// A large offline batch run two ways: ProcessQueries over a vector of query strings, joined
+// afterwards as ProcessQueriesJoined used to, which holds every result until the batch is
+// done, and ProcessQueriesStream pulling queries from a generator and handing results on as
+// they come. Reported are the time to the first result, the total time and the growth of
+// peak resident memory. The streaming run goes first, so the peak it leaves behind does not
+// hide the growth of the other one.
+//
+// Build from the search-server folder:
+//   g++ -std=c++17 -O2 -I. benchmark/process_queries_benchmark.cpp process_queries.cpp search_server.cpp document.cpp
+//       string_processing.cpp term_dictionary.cpp posting_list.cpp snapshot.cpp query_cache.cpp index_segment.cpp thread_pool.cpp metrics.cpp
+//       -ltbb -lpthread -o process_queries_benchmark
+
+#include "process_queries.h"
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    const int DOCUMENT_COUNT = 50000;
+    const int QUERY_COUNT = 200000;
+
+    string MakeQuery(int index)
+    {
+        return "w"s + to_string(index % 997) + " w"s + to_string(index * 7 % 2003) + " -w"s + to_string(index % 13);
+    }
+
+    double GetPeakMemoryMegabytes()
+    {
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss / 1024.0;
+    }
+
+    double GetMilliseconds(chrono::steady_clock::time_point start)
+    {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main()
+{
+    mt19937 generator(42);
+    SearchServer search_server(""s);
+    for (int id = 0; id < DOCUMENT_COUNT; ++id)
+    {
+        string text;
+        for (int i = 0; i < 20; ++i)
+        {
+            text += "w"s + to_string(generator() % 3000) + " "s;
+        }
+        search_server.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 10});
+    }
+
+    cout << "documents: "s << DOCUMENT_COUNT << ", queries: "s << QUERY_COUNT << endl;
+    cout << fixed << setprecision(1);
+    cout << "mode                          first result, ms   total, ms   peak memory growth, MB"s << endl;
+
+    uint64_t stream_checksum = 0;
+    {
+        double memory = GetPeakMemoryMegabytes();
+        const auto start = chrono::steady_clock::now();
+        optional<double> first_result;
+        int next_query = 0;
+        ProcessQueriesStream(
+            search_server, [&next_query]() -> optional<string>
+            {
+                if (next_query == QUERY_COUNT)
+                {
+                    return nullopt;
+                }
+                return MakeQuery(next_query++); },
+            [&](size_t, vector<Document> documents)
+            {
+                if (!first_result)
+                {
+                    first_result = GetMilliseconds(start);
+                }
+                for (const Document &document : documents)
+                {
+                    stream_checksum += document.id;
+                }
+            });
+        const double total = GetMilliseconds(start);
+        memory = GetPeakMemoryMegabytes() - memory;
+        cout << "ProcessQueriesStream          "s << setw(16) << *first_result << setw(12) << total << setw(25) << memory << endl;
+    }
+
+    uint64_t joined_checksum = 0;
+    {
+        double memory = GetPeakMemoryMegabytes();
+        const auto start = chrono::steady_clock::now();
+        vector<string> queries;
+        for (int i = 0; i < QUERY_COUNT; ++i)
+        {
+            queries.push_back(MakeQuery(i));
+        }
+        vector<Document> documents;
+        for (const auto &query_documents : ProcessQueries(search_server, queries))
+        {
+            documents.insert(documents.end(), query_documents.begin(), query_documents.end());
+        }
+        const double total = GetMilliseconds(start);
+        for (const Document &document : documents)
+        {
+            joined_checksum += document.id;
+        }
+        memory = GetPeakMemoryMegabytes() - memory;
+        cout << "ProcessQueries, then joined  "s << setw(16) << total << setw(12) << total << setw(25) << memory << endl;
+    }
+    cout << (stream_checksum == joined_checksum ? "results match"s : "results differ"s) << endl;
+    return stream_checksum == joined_checksum ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+// Deduplication of a corpus where every fifth document repeats an earlier one with its words
+// shuffled. Compares the former pass, which keyed a map by the set of each document's words
+// taken from GetWordFrequencies, with RemoveDuplicates over hashed term sets, and reports
+// RemoveNearDuplicates at 0.8 on the same corpus with one word of each copy replaced.
+// Every run starts from its own copy of the server and all must remove the expected ids.
+//
+// Build from the search-server folder:
+//   g++ -std=c++17 -O2 -I. benchmark/remove_duplicates_benchmark.cpp remove_duplicates.cpp search_server.cpp
+//       document.cpp string_processing.cpp term_dictionary.cpp posting_list.cpp snapshot.cpp query_cache.cpp
+//       index_segment.cpp thread_pool.cpp metrics.cpp -ltbb -lpthread -o remove_duplicates_benchmark
+
+#include "remove_duplicates.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    const int DOCUMENT_COUNT = 200000;
+    const int WORD_COUNT = 30;
+
+    // the pass RemoveDuplicates used to make, with the kept id fixed to the first one seen
+    void RemoveDuplicatesWithWordSets(SearchServer &search_server)
+    {
+        map<set<string_view>, int> words_to_id;
+        set<int> duplicate_ids;
+        for (const int id : search_server)
+        {
+            set<string_view> words;
+            for (const auto &[word, freq] : search_server.GetWordFrequencies(id))
+            {
+                words.insert(word);
+            }
+            if (!words_to_id.emplace(words, id).second)
+            {
+                duplicate_ids.insert(id);
+            }
+        }
+        for (const int id : duplicate_ids)
+        {
+            cout << "Found duplicate document id " << id << endl;
+            search_server.RemoveDocument(id);
+        }
+    }
+
+    SearchServer MakeServer(const vector<string> &texts)
+    {
+        SearchServer search_server(""s);
+        for (int id = 0; id < static_cast<int>(texts.size()); ++id)
+        {
+            search_server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, {1});
+        }
+        return search_server;
+    }
+
+    template <typename Function>
+    double MeasureRemoval(const vector<string> &texts, Function function, int &left_count)
+    {
+        SearchServer search_server = MakeServer(texts);
+        // the found ids are printed, keep them out of the report
+        ostringstream found;
+        streambuf *const output = cout.rdbuf(found.rdbuf());
+        const auto start = chrono::steady_clock::now();
+        function(search_server);
+        const double time = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout.rdbuf(output);
+        left_count = search_server.GetDocumentCount();
+        return time;
+    }
+}
+
+int main()
+{
+    mt19937 generator(42);
+    vector<vector<string>> words(DOCUMENT_COUNT);
+    vector<string> texts;
+    vector<string> near_texts;
+    int duplicate_count = 0;
+    for (int id = 0; id < DOCUMENT_COUNT; ++id)
+    {
+        bool is_copy = id > 0 && id % 5 == 0;
+        if (is_copy)
+        {
+            words[id] = words[generator() % id];
+            shuffle(words[id].begin(), words[id].end(), generator);
+            ++duplicate_count;
+        }
+        else
+        {
+            for (int i = 0; i < WORD_COUNT; ++i)
+            {
+                words[id].push_back("w"s + to_string(generator() % 100000));
+            }
+        }
+        string text;
+        for (const string &word : words[id])
+        {
+            text += word + " "s;
+        }
+        texts.push_back(text);
+        // a copy with one word changed is still about 0.9 alike
+        near_texts.push_back(is_copy ? text + "extra"s + to_string(id) : text);
+    }
+
+    cout << "documents: "s << DOCUMENT_COUNT << ", duplicates: "s << duplicate_count << endl;
+    cout << fixed << setprecision(1);
+    cout << "pass                                     time, ms   removed"s << endl;
+    int left_count = 0;
+    bool is_correct = true;
+    double time = MeasureRemoval(texts, RemoveDuplicatesWithWordSets, left_count);
+    cout << "word sets in a map                       "s << setw(8) << time << setw(10) << DOCUMENT_COUNT - left_count << endl;
+    is_correct = is_correct && DOCUMENT_COUNT - left_count == duplicate_count;
+    time = MeasureRemoval(texts, RemoveDuplicates, left_count);
+    cout << "RemoveDuplicates                         "s << setw(8) << time << setw(10) << DOCUMENT_COUNT - left_count << endl;
+    is_correct = is_correct && DOCUMENT_COUNT - left_count == duplicate_count;
+    time = MeasureRemoval(near_texts, [](SearchServer &search_server)
+                          { RemoveNearDuplicates(search_server, 0.8); },
+                          left_count);
+    cout << "RemoveNearDuplicates(0.8), near copies   "s << setw(8) << time << setw(10) << DOCUMENT_COUNT - left_count << endl;
+    is_correct = is_correct && DOCUMENT_COUNT - left_count == duplicate_count;
+    return is_correct ? 0 : 1;
+}
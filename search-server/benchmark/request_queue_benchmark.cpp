@@ -0,0 +1,106 @@
+// Throughput of RequestQueue fed by 1, 2, 4 and 8 threads against the same bookkeeping behind
+// one mutex: a deque of requests pruned to the window. The index is tiny, so the queries are
+// cheap and the cost of recording them shows.
+//
+// Build from the search-server folder:
+//   g++ -std=c++17 -O2 -I. benchmark/request_queue_benchmark.cpp request_queue.cpp search_server.cpp document.cpp
+//       string_processing.cpp term_dictionary.cpp posting_list.cpp snapshot.cpp query_cache.cpp index_segment.cpp
+//       thread_pool.cpp metrics.cpp -ltbb -lpthread -o request_queue_benchmark
+
+#include "request_queue.h"
+
+#include <chrono>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    const int DOCUMENT_COUNT = 100;
+    const int REQUEST_COUNT = 200000;
+
+    // the single-threaded queue with a lock around it
+    class LockedRequestQueue
+    {
+    public:
+        explicit LockedRequestQueue(const SearchServer &search_server)
+            : search_server_(search_server)
+        {
+        }
+
+        vector<Document> AddFindRequest(string_view raw_query)
+        {
+            const auto start_time = chrono::steady_clock::now();
+            const auto result = search_server_.FindTopDocuments(raw_query);
+            const auto end_time = chrono::steady_clock::now();
+            lock_guard guard(mutex_);
+            while (!requests_.empty() && end_time - requests_.front().end_time >= chrono::minutes(1))
+            {
+                requests_.pop_front();
+            }
+            requests_.push_back({end_time, end_time - start_time, result.size()});
+            return result;
+        }
+
+    private:
+        struct Request
+        {
+            chrono::steady_clock::time_point end_time;
+            chrono::steady_clock::duration latency;
+            size_t result_count;
+        };
+
+        const SearchServer &search_server_;
+        mutex mutex_;
+        deque<Request> requests_;
+    };
+
+    template <typename Queue>
+    double MeasureThroughput(Queue &queue, int thread_count)
+    {
+        const auto start = chrono::steady_clock::now();
+        vector<thread> threads;
+        for (int i = 0; i < thread_count; ++i)
+        {
+            threads.emplace_back([&queue, thread_count, i]()
+                                 {
+                                     const string query = "w"s + to_string(i % 10);
+                                     for (int j = 0; j < REQUEST_COUNT / thread_count; ++j)
+                                     {
+                                         queue.AddFindRequest(query);
+                                     } });
+        }
+        for (thread &thread : threads)
+        {
+            thread.join();
+        }
+        return REQUEST_COUNT / chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main()
+{
+    SearchServer search_server(""s);
+    for (int id = 0; id < DOCUMENT_COUNT; ++id)
+    {
+        search_server.AddDocument(id, "w"s + to_string(id % 10) + " v"s + to_string(id), DocumentStatus::ACTUAL, {1});
+    }
+    cout << "hardware threads: "s << thread::hardware_concurrency() << endl;
+    cout << fixed << setprecision(0);
+    for (const int thread_count : {1, 2, 4, 8})
+    {
+        LockedRequestQueue locked_queue(search_server);
+        RequestQueue queue(search_server);
+        cout << thread_count << " threads, requests/s: mutex and deque "s << MeasureThroughput(locked_queue, thread_count)
+             << ", ring "s << MeasureThroughput(queue, thread_count) << endl;
+        const RequestQueueStats stats = queue.GetStats();
+        cout << "    ring window: "s << stats.request_count << " requests, "s << stats.queries_per_second << " QPS, p50/p95/p99 ns "s
+             << stats.latency_p50.count() << '/' << stats.latency_p95.count() << '/' << stats.latency_p99.count() << endl;
+    }
+}
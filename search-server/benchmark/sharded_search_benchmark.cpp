@@ -0,0 +1,114 @@
+// Scatter-gather over 1, 2, 4 and 8 shards against one SearchServer holding every document.
+// For each shard count the benchmark reports the mean latency of a query searching the shards
+// one by one and under std::execution::par, and checks the merged results against the single
+// server: ids must come in the same order and relevance must not differ at all.
+//
+// Build from the search-server folder:
+//   g++ -std=c++17 -O2 -I. benchmark/sharded_search_benchmark.cpp sharded_search_server.cpp search_server.cpp
+//       document.cpp string_processing.cpp term_dictionary.cpp posting_list.cpp snapshot.cpp query_cache.cpp
+//       index_segment.cpp thread_pool.cpp metrics.cpp -ltbb -lpthread -o sharded_search_benchmark
+
+#include "sharded_search_server.h"
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    const int DOCUMENT_COUNT = 200000;
+    const int QUERY_COUNT = 200;
+
+    string MakeText(mt19937 &generator)
+    {
+        string text;
+        for (int i = 0; i < 25; ++i)
+        {
+            text += "w"s + to_string(generator() % 5000) + " "s;
+        }
+        return text;
+    }
+
+    template <typename ExecutionPolicy>
+    double MeasureLatency(const ExecutionPolicy &policy, const ShardedSearchServer &search_server, const vector<string> &queries)
+    {
+        const auto start = chrono::steady_clock::now();
+        for (const string &query : queries)
+        {
+            search_server.FindTopDocuments(policy, query);
+        }
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / queries.size();
+    }
+}
+
+int main()
+{
+    vector<string> texts;
+    mt19937 generator(42);
+    for (int id = 0; id < DOCUMENT_COUNT; ++id)
+    {
+        texts.push_back(MakeText(generator));
+    }
+    vector<string> queries;
+    for (int i = 0; i < QUERY_COUNT; ++i)
+    {
+        queries.push_back("w"s + to_string(generator() % 5000) + " w"s + to_string(generator() % 5000) + " w"s +
+                          to_string(generator() % 500) + " -w"s + to_string(generator() % 5000));
+    }
+
+    SearchServer single_server(""s);
+    for (int id = 0; id < DOCUMENT_COUNT; ++id)
+    {
+        single_server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, {id % 10});
+    }
+    vector<vector<Document>> expected;
+    auto start = chrono::steady_clock::now();
+    for (const string &query : queries)
+    {
+        expected.push_back(single_server.FindTopDocuments(query));
+    }
+    const double single_latency = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / QUERY_COUNT;
+
+    cout << "documents: "s << DOCUMENT_COUNT << ", queries: "s << QUERY_COUNT << ", hardware threads: "s
+         << thread::hardware_concurrency() << endl;
+    cout << fixed << setprecision(3);
+    cout << "single server: "s << single_latency << " ms per query"s << endl;
+    cout << "shards   seq, ms   par, ms   order mismatches   max relevance difference"s << endl;
+    int mismatch_count = 0;
+    for (const size_t shard_count : {1, 2, 4, 8})
+    {
+        ShardedSearchServer search_server(shard_count, ""s);
+        for (int id = 0; id < DOCUMENT_COUNT; ++id)
+        {
+            search_server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, {id % 10});
+        }
+        int order_mismatch_count = 0;
+        double max_difference = 0.0;
+        for (int i = 0; i < QUERY_COUNT; ++i)
+        {
+            const auto documents = search_server.FindTopDocuments(execution::par, queries[i]);
+            if (documents.size() != expected[i].size())
+            {
+                ++order_mismatch_count;
+                continue;
+            }
+            for (size_t j = 0; j < documents.size(); ++j)
+            {
+                order_mismatch_count += documents[j].id == expected[i][j].id ? 0 : 1;
+                max_difference = max(max_difference, abs(documents[j].relevance - expected[i][j].relevance));
+            }
+        }
+        mismatch_count += order_mismatch_count + (max_difference > 0.0 ? 1 : 0);
+        cout << setw(6) << shard_count << setw(10) << MeasureLatency(execution::seq, search_server, queries)
+             << setw(10) << MeasureLatency(execution::par, search_server, queries) << setw(19) << order_mismatch_count
+             << setw(27) << scientific << max_difference << fixed << endl;
+    }
+    return mismatch_count == 0 ? 0 : 1;
+}
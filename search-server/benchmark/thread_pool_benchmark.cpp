@@ -0,0 +1,87 @@
+// Scaling of the work-stealing ThreadPool on 1, 2, 4, 8 and 16 threads against
+// std::execution::par. Two workloads: the latency of one parallel query, where only the
+// ranges inside the query run in parallel, and the time of a ProcessQueries batch, where the
+// queries and the ranges inside each of them share the pool. Numbers above the hardware
+// thread count printed first only show the cost of oversubscribing.
+//
+// Build from the search-server folder:
+//   g++ -std=c++17 -O2 -I. benchmark/thread_pool_benchmark.cpp thread_pool.cpp metrics.cpp process_queries.cpp search_server.cpp
+//       document.cpp string_processing.cpp term_dictionary.cpp posting_list.cpp snapshot.cpp query_cache.cpp
+//       index_segment.cpp -ltbb -lpthread -o thread_pool_benchmark
+
+#include "process_queries.h"
+#include "thread_pool.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    const int DOCUMENT_COUNT = 200000;
+    const int BATCH_QUERY_COUNT = 400;
+    const int REPEAT_COUNT = 20;
+
+    struct Timings
+    {
+        double query_latency = 0.0;
+        double batch_time = 0.0;
+    };
+
+    Timings Measure(SearchServer &search_server, const vector<string> &queries)
+    {
+        Timings timings;
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < REPEAT_COUNT; ++i)
+        {
+            search_server.FindTopDocuments(execution::par, queries[i]);
+        }
+        timings.query_latency = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / REPEAT_COUNT;
+        start = chrono::steady_clock::now();
+        ProcessQueries(search_server, queries);
+        timings.batch_time = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        return timings;
+    }
+}
+
+int main()
+{
+    mt19937 generator(42);
+    SearchServer search_server(""s);
+    // exhaustive scoring keeps every range busy, MaxScore would skip most of the work
+    search_server.SetQueryEvaluation(QueryEvaluation::EXHAUSTIVE);
+    for (int id = 0; id < DOCUMENT_COUNT; ++id)
+    {
+        string text;
+        for (int i = 0; i < 30; ++i)
+        {
+            text += "w"s + to_string(generator() % 500) + " "s;
+        }
+        search_server.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 10});
+    }
+    vector<string> queries;
+    for (int i = 0; i < BATCH_QUERY_COUNT; ++i)
+    {
+        queries.push_back("w"s + to_string(i % 500) + " w"s + to_string(i * 7 % 500) + " w"s + to_string(i * 13 % 500) + " -w"s + to_string(i % 17));
+    }
+
+    cout << "documents: "s << DOCUMENT_COUNT << ", batch: "s << BATCH_QUERY_COUNT << " queries, hardware threads: "s
+         << thread::hardware_concurrency() << endl;
+    cout << fixed << setprecision(2);
+    cout << "executor              one query, ms   batch, ms"s << endl;
+    const Timings par_timings = Measure(search_server, queries);
+    cout << "std::execution::par"s << setw(17) << par_timings.query_latency << setw(12) << par_timings.batch_time << endl;
+    for (const size_t thread_count : {1, 2, 4, 8, 16})
+    {
+        search_server.SetExecutor(make_shared<ThreadPool>(thread_count));
+        const Timings timings = Measure(search_server, queries);
+        cout << "ThreadPool("s << setw(2) << thread_count << ")"s << setw(22) << timings.query_latency
+             << setw(12) << timings.batch_time << endl;
+    }
+}
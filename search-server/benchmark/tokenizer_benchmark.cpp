@@ -0,0 +1,113 @@
+// Tokenization throughput in GB/s over document-sized texts: the former find-based
+// splitter followed by a per-word scan for control characters, against the single-pass
+// vectorized tokenizer writing into a reused buffer.
+//
+// Build from the search-server folder:
+//   g++ -std=c++17 -O2 -I. benchmark/tokenizer_benchmark.cpp string_processing.cpp -o tokenizer_benchmark
+
+#include "string_processing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    vector<string_view> SplitWithFind(string_view str)
+    {
+        vector<string_view> result;
+        int64_t pos = str.find_first_not_of(" ");
+        const int64_t pos_end = str.npos;
+        while (pos != pos_end)
+        {
+            int64_t space = str.find(' ', pos);
+            result.push_back(space == pos_end ? str.substr(pos) : str.substr(pos, space - pos));
+            pos = str.find_first_not_of(" ", space);
+        }
+        return result;
+    }
+
+    bool IsValidWordScalar(string_view word)
+    {
+        return none_of(word.begin(), word.end(), [](char c)
+                       { return c >= '\0' && c < ' '; });
+    }
+
+    vector<string> GenerateTexts(size_t text_count, size_t words_per_text)
+    {
+        mt19937 generator(42);
+        // word lengths roughly follow natural text, a few words are non-ASCII
+        uniform_int_distribution<int> length(1, 12);
+        uniform_int_distribution<int> letter('a', 'z');
+        vector<string> texts(text_count);
+        for (string &text : texts)
+        {
+            for (size_t i = 0; i < words_per_text; ++i)
+            {
+                const int word_length = length(generator);
+                for (int j = 0; j < word_length; ++j)
+                {
+                    text += static_cast<char>(letter(generator));
+                }
+                if (i % 17 == 0)
+                {
+                    text += "\xD0\xB6"s;
+                }
+                text += i % 9 == 0 ? "  "s : " "s;
+            }
+        }
+        return texts;
+    }
+
+    template <typename Function>
+    double MeasureGigabytesPerSecond(const vector<string> &texts, size_t total_bytes, Function tokenize)
+    {
+        size_t checksum = 0;
+        const auto start = chrono::steady_clock::now();
+        for (const string &text : texts)
+        {
+            checksum += tokenize(text);
+        }
+        const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (checksum == 0)
+        {
+            cerr << "no words"s << endl;
+        }
+        return total_bytes / seconds / 1e9;
+    }
+}
+
+int main()
+{
+    const vector<string> texts = GenerateTexts(200000, 100);
+    size_t total_bytes = 0;
+    for (const string &text : texts)
+    {
+        total_bytes += text.size();
+    }
+
+    const double find_throughput = MeasureGigabytesPerSecond(texts, total_bytes, [](const string &text)
+                                                             {
+                                                                 const vector<string_view> words = SplitWithFind(text);
+                                                                 return static_cast<size_t>(all_of(words.begin(), words.end(), IsValidWordScalar)) + words.size(); });
+    const double allocating_throughput = MeasureGigabytesPerSecond(texts, total_bytes, [](const string &text)
+                                                                   { return SplitIntoWordsView(text).size(); });
+    vector<string_view> words;
+    const double buffer_throughput = MeasureGigabytesPerSecond(texts, total_bytes, [&words](const string &text)
+                                                               { return SplitIntoWordsView(text, words) + words.size(); });
+
+    cout << "texts: "s << texts.size() << ", megabytes: "s << total_bytes / 1000000 << ", tokenizer: "s << GetTokenizerName() << endl;
+    cout << fixed << setprecision(2);
+    cout << "tokenizer                              GB/s"s << endl;
+    cout << "find + per-word validation             "s << find_throughput << endl;
+    cout << "single pass, new vector per call       "s << allocating_throughput << endl;
+    cout << "single pass, reused buffer             "s << buffer_throughput << endl;
+}
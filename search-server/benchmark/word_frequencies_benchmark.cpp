@@ -0,0 +1,98 @@
+// GetWordFrequencies for every document, as the former map returned by value and as the view
+// over the forward index it returns now, and the memory of the forward index itself: the former
+// map<int, map<string_view, double>> rebuilt from the views against the bytes of the contiguous
+// (term id, term count) entries, 8 per word of a document.
+//
+// Build from the search-server folder:
+//   g++ -std=c++17 -O2 -I. benchmark/word_frequencies_benchmark.cpp search_server.cpp document.cpp string_processing.cpp
+//       term_dictionary.cpp posting_list.cpp snapshot.cpp query_cache.cpp index_segment.cpp thread_pool.cpp metrics.cpp
+//       -ltbb -lpthread -o word_frequencies_benchmark
+
+#include "search_server.h"
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+namespace
+{
+    const int DOCUMENT_COUNT = 200000;
+
+    double GetPeakMemoryMegabytes()
+    {
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss / 1024.0;
+    }
+
+    template <typename Function>
+    double MeasureMilliseconds(Function function)
+    {
+        const auto start = chrono::steady_clock::now();
+        function();
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main()
+{
+    mt19937 generator(42);
+    SearchServer search_server(""s);
+    size_t entry_count = 0;
+    for (int id = 0; id < DOCUMENT_COUNT; ++id)
+    {
+        string text;
+        for (int i = 0; i < 30; ++i)
+        {
+            text += "w"s + to_string(generator() % 20000) + " "s;
+        }
+        search_server.AddDocument(id, text, DocumentStatus::ACTUAL, {1});
+        entry_count += search_server.GetWordFrequencies(id).size();
+    }
+
+    cout << "documents: "s << DOCUMENT_COUNT << ", forward index entries: "s << entry_count << endl;
+    cout << fixed << setprecision(1);
+    double map_sum = 0.0;
+    const double map_time = MeasureMilliseconds([&]()
+                                                {
+                                                    for (const int id : search_server)
+                                                    {
+                                                        const auto frequencies = search_server.GetWordFrequencies(id);
+                                                        const map<string_view, double> word_freqs(frequencies.begin(), frequencies.end());
+                                                        for (const auto &[word, freq] : word_freqs)
+                                                        {
+                                                            map_sum += freq;
+                                                        }
+                                                    } });
+    double view_sum = 0.0;
+    const double view_time = MeasureMilliseconds([&]()
+                                                 {
+                                                     for (const int id : search_server)
+                                                     {
+                                                         for (const auto [word, freq] : search_server.GetWordFrequencies(id))
+                                                         {
+                                                             view_sum += freq;
+                                                         }
+                                                     } });
+    cout << "GetWordFrequencies for all documents, ms: copied into a map "s << map_time << ", view "s << view_time << endl;
+
+    const double memory = GetPeakMemoryMegabytes();
+    map<int, map<string_view, double>> id_to_word_freqs;
+    for (const int id : search_server)
+    {
+        const auto frequencies = search_server.GetWordFrequencies(id);
+        id_to_word_freqs.emplace(id, map<string_view, double>(frequencies.begin(), frequencies.end()));
+    }
+    cout << "forward index, MB: nested maps "s << GetPeakMemoryMegabytes() - memory << ", contiguous entries "s
+         << entry_count * 8 / 1024.0 / 1024.0 << endl;
+    return abs(map_sum - view_sum) < 1e-6 * view_sum ? 0 : 1;
+}
@@ -9,6 +9,7 @@
 #include <random>
 #include <algorithm>
 #include <future>
+#include <execution>
 
 template <typename Key, typename Value>
 class ConcurrentMap
@@ -61,6 +62,20 @@ public:
         return result;
     }
 
+    std::size_t GetBucketCount() const
+    {
+        return buckets_.size();
+    }
+
+    template <typename ExecutionPolicy, typename Function>
+    void ForEachBucket(const ExecutionPolicy &policy, Function function)
+    {
+        std::for_each(policy, buckets_.begin(), buckets_.end(), [this, &function](Bucket &bucket)
+                      {
+                          std::lock_guard g(bucket.mutex);
+                          function(static_cast<std::size_t>(&bucket - buckets_.data()), bucket.map); });
+    }
+
 private:
     std::vector<Bucket> buckets_;
 };
\ No newline at end of file
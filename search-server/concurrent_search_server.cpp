@@ -0,0 +1,130 @@
+#include "concurrent_search_server.h"
+
+using namespace std;
+
+// the counts and the published version are sequentially consistent: a reader that still sees
+// its version published when it leaves comes before the writer's check of the count
+void ConcurrentSearchServer::Versions::Release(size_t version)
+{
+    if (reader_counts[version].fetch_sub(1) == 1 && published.load() != version)
+    {
+        lock_guard guard(released_mutex);
+        released.notify_all();
+    }
+}
+
+shared_ptr<const SearchServer> ConcurrentSearchServer::Pin() const
+{
+    while (true)
+    {
+        const size_t version = versions_->published.load();
+        versions_->reader_counts[version].fetch_add(1);
+        // counted in before the writer swapped the version, or left it alone
+        if (versions_->published.load() == version)
+        {
+            return shared_ptr<const SearchServer>(versions_->servers[version].get(), [versions = versions_, version](const SearchServer *)
+                                                  { versions->Release(version); });
+        }
+        versions_->Release(version);
+    }
+}
+
+int ConcurrentSearchServer::GetDocumentCount() const
+{
+    return Pin()->GetDocumentCount();
+}
+
+void ConcurrentSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status,
+                                         const vector<int> &ratings)
+{
+    Update([document_id, document = string(document), status, ratings](SearchServer &search_server)
+           { search_server.AddDocument(document_id, document, status, ratings); });
+}
+
+void ConcurrentSearchServer::RemoveDocument(int document_id)
+{
+    Update([document_id](SearchServer &search_server)
+           { search_server.RemoveDocument(document_id); });
+}
+
+void ConcurrentSearchServer::Compact()
+{
+    Update([](SearchServer &search_server)
+           { search_server.Compact(); });
+}
+
+void ConcurrentSearchServer::LoadSnapshot(const string &path)
+{
+    Update([path](SearchServer &search_server)
+           { search_server.LoadSnapshot(path); });
+}
+
+void ConcurrentSearchServer::SetQueryEvaluation(QueryEvaluation query_evaluation)
+{
+    Update([query_evaluation](SearchServer &search_server)
+           { search_server.SetQueryEvaluation(query_evaluation); });
+}
+
+void ConcurrentSearchServer::SetQueryCacheCapacity(size_t capacity)
+{
+    Update([capacity](SearchServer &search_server)
+           { search_server.SetQueryCacheCapacity(capacity); });
+}
+
+void ConcurrentSearchServer::SetAutoCompaction(bool is_enabled)
+{
+    Update([is_enabled](SearchServer &search_server)
+           { search_server.SetAutoCompaction(is_enabled); });
+}
+
+void ConcurrentSearchServer::SetExecutor(shared_ptr<ThreadPool> executor, size_t min_range_document_count)
+{
+    Update([executor, min_range_document_count](SearchServer &search_server)
+           { search_server.SetExecutor(executor, min_range_document_count); });
+}
+
+void ConcurrentSearchServer::Update(Change change)
+{
+    lock_guard guard(writer_mutex_);
+    const size_t version = 1 - versions_->published.load(memory_order_relaxed);
+    SearchServer &search_server = *versions_->servers[version];
+
+    // grace period: the version was unpublished by the previous update, wait until
+    // every reader that pinned it before has released it
+    {
+        unique_lock lock(versions_->released_mutex);
+        versions_->released.wait(lock, [this, version]()
+                                 { return versions_->reader_counts[version].load() == 0; });
+    }
+
+    // a change that failed on the other version fails the same way here, possibly
+    // after changing the index, as AddDocuments does, so it is replayed all the same
+    for (const Change &pending_change : pending_changes_)
+    {
+        try
+        {
+            pending_change(search_server);
+        }
+        catch (const exception &)
+        {
+        }
+    }
+    pending_changes_.clear();
+
+    exception_ptr error;
+    try
+    {
+        change(search_server);
+    }
+    catch (const exception &)
+    {
+        error = current_exception();
+    }
+    pending_changes_.push_back(move(change));
+
+    versions_->published.store(version);
+    if (error)
+    {
+        rethrow_exception(error);
+    }
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "search_server.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// SearchServer for concurrent queries and updates. Two versions are kept; a writer changes
+// the unpublished one, publishes it and later replays the same change on the other version
+// once the last reader of it has unpinned it. A reader counts itself in on the published
+// version with atomics alone and retries if a writer swapped it meanwhile; it takes no lock
+// besides what the allocator does for the pin and never waits for a writer.
+class ConcurrentSearchServer
+{
+public:
+    template <typename StopWords>
+    explicit ConcurrentSearchServer(const StopWords &stop_words);
+
+    // the pinned version does not change, but writers wait for it to be released,
+    // so keep a pin for one query rather than for a whole batch; a pin keeps the
+    // versions alive and may outlive the server
+    std::shared_ptr<const SearchServer> Pin() const;
+
+    template <typename... Args>
+    std::vector<Document> FindTopDocuments(Args &&...args) const
+    {
+        return Pin()->FindTopDocuments(std::forward<Args>(args)...);
+    }
+
+    int GetDocumentCount() const;
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status,
+                     const std::vector<int> &ratings);
+
+    template <typename ExecutionPolicy, typename DocumentRange>
+    void AddDocuments(const ExecutionPolicy &policy, const DocumentRange &documents);
+
+    template <typename DocumentRange>
+    void AddDocuments(const DocumentRange &documents);
+
+    void RemoveDocument(int document_id);
+
+    void Compact();
+
+    void LoadSnapshot(const std::string &path);
+
+    void SetQueryEvaluation(QueryEvaluation query_evaluation);
+
+    void SetQueryCacheCapacity(std::size_t capacity);
+
+    void SetAutoCompaction(bool is_enabled);
+
+    // both versions share the pool
+    void SetExecutor(std::shared_ptr<ThreadPool> executor,
+                     std::size_t min_range_document_count = MIN_PARALLEL_RANGE_DOCUMENT_COUNT);
+
+private:
+    using Change = std::function<void(SearchServer &)>;
+
+    // shared by the server and every pin, so a pin outlives neither the version it
+    // points to nor the count its release updates
+    struct Versions
+    {
+        template <typename StopWords>
+        explicit Versions(const StopWords &stop_words)
+            : servers{std::make_unique<SearchServer>(stop_words), std::make_unique<SearchServer>(stop_words)}
+        {
+        }
+
+        // both received the same changes, except the pending ones
+        std::unique_ptr<SearchServer> servers[2];
+
+        // pins of each version, readers that found it unpublished included until they retry
+        std::atomic<std::size_t> reader_counts[2] = {0, 0};
+
+        std::atomic<std::size_t> published = 0;
+
+        // a writer waits here for the last reader of the unpublished version
+        std::mutex released_mutex;
+        std::condition_variable released;
+
+        void Release(std::size_t version);
+    };
+
+    std::shared_ptr<Versions> versions_;
+
+    std::mutex writer_mutex_;
+    // applied to the published version, still to be replayed on the other one
+    std::vector<Change> pending_changes_;
+
+    void Update(Change change);
+};
+
+template <typename StopWords>
+ConcurrentSearchServer::ConcurrentSearchServer(const StopWords &stop_words)
+    : versions_(std::make_shared<Versions>(stop_words))
+{
+}
+
+template <typename ExecutionPolicy, typename DocumentRange>
+void ConcurrentSearchServer::AddDocuments(const ExecutionPolicy &policy, const DocumentRange &documents)
+{
+    // the change is replayed later, so it owns the texts; copies of it share them
+    auto texts = std::make_shared<std::vector<std::string>>();
+    std::vector<NewDocument> copies;
+    for (const NewDocument &document : documents)
+    {
+        texts->emplace_back(document.text);
+        copies.push_back(document);
+    }
+    for (std::size_t i = 0; i < copies.size(); ++i)
+    {
+        copies[i].text = (*texts)[i];
+    }
+    Update([policy, copies = std::move(copies), texts = std::move(texts)](SearchServer &search_server)
+           { search_server.AddDocuments(policy, copies); });
+}
+
+template <typename DocumentRange>
+void ConcurrentSearchServer::AddDocuments(const DocumentRange &documents)
+{
+    AddDocuments(std::execution::seq, documents);
+}
@@ -24,6 +24,15 @@ enum class DocumentStatus
     REMOVED,
 };
 
+// input of SearchServer::AddDocuments, text must stay alive until the call returns
+struct NewDocument
+{
+    int id = 0;
+    std::string_view text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
 std::ostream &operator<<(std::ostream &out, const Document &document);
 
 void PrintDocument(const Document &document);
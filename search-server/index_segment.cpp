@@ -0,0 +1,166 @@
+#include "index_segment.h"
+
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+IndexSegment::IndexSegment(uint32_t first_document_index)
+    : first_document_index_(first_document_index), end_document_index_(first_document_index)
+{
+}
+
+IndexSegment::IndexSegment(uint32_t first_document_index, uint32_t end_document_index,
+                           vector<PostingList> term_postings)
+    : first_document_index_(first_document_index), end_document_index_(end_document_index), is_sealed_(true)
+{
+    for (size_t term = 0; term < term_postings.size(); ++term)
+    {
+        if (!term_postings[term].empty())
+        {
+            terms_.push_back(static_cast<TermId>(term));
+            postings_.push_back(move(term_postings[term]));
+            postings_.back().ShrinkToFit();
+        }
+    }
+}
+
+void IndexSegment::Append(TermId term, uint32_t document_index, uint32_t term_count)
+{
+    if (term >= term_positions_.size())
+    {
+        term_positions_.resize(term + 1, NO_POSITION);
+    }
+    uint32_t &position = term_positions_[term];
+    if (position == NO_POSITION)
+    {
+        position = static_cast<uint32_t>(terms_.size());
+        terms_.push_back(term);
+        postings_.emplace_back();
+    }
+    postings_[position].Append(document_index, term_count);
+    ExtendTo(document_index + 1);
+}
+
+void IndexSegment::ExtendTo(uint32_t end_document_index)
+{
+    end_document_index_ = max(end_document_index_, end_document_index);
+}
+
+IndexSegment IndexSegment::Seal(uint32_t next_first_document_index)
+{
+    vector<pair<TermId, uint32_t>> order;
+    order.reserve(terms_.size());
+    for (const TermId term : terms_)
+    {
+        order.push_back({term, term_positions_[term]});
+        term_positions_[term] = NO_POSITION;
+    }
+    sort(order.begin(), order.end());
+    vector<PostingList> postings;
+    postings.reserve(order.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        terms_[i] = order[i].first;
+        postings.push_back(move(postings_[order[i].second]));
+    }
+    postings_ = move(postings);
+    is_sealed_ = true;
+
+    // the table is all NO_POSITION again, so the next segment reuses it instead of growing its own;
+    // it will likely see as many terms as this one did
+    IndexSegment next(next_first_document_index);
+    next.term_positions_.swap(term_positions_);
+    next.terms_.reserve(terms_.size());
+    next.postings_.reserve(postings_.size());
+    return next;
+}
+
+const PostingList *IndexSegment::FindPostings(TermId term) const
+{
+    if (!is_sealed_)
+    {
+        return term < term_positions_.size() && term_positions_[term] != NO_POSITION ? &postings_[term_positions_[term]] : nullptr;
+    }
+    const auto it = lower_bound(terms_.begin(), terms_.end(), term);
+    return it == terms_.end() || *it != term ? nullptr : &postings_[it - terms_.begin()];
+}
+
+size_t IndexSegment::GetMemoryUsage() const
+{
+    size_t memory_usage = sizeof(*this) + terms_.capacity() * sizeof(TermId) +
+                          (postings_.capacity() - postings_.size()) * sizeof(PostingList);
+    for (const PostingList &postings : postings_)
+    {
+        memory_usage += postings.GetMemoryUsage();
+    }
+    return memory_usage + term_positions_.capacity() * sizeof(uint32_t);
+}
+
+IndexSegment IndexSegment::Merge(const vector<shared_ptr<const IndexSegment>> &segments)
+{
+    size_t term_count = 0;
+    for (const auto &segment : segments)
+    {
+        term_count += segment->terms_.size();
+    }
+    IndexSegment merged(segments.front()->first_document_index_);
+    merged.end_document_index_ = segments.back()->end_document_index_;
+    merged.terms_.reserve(term_count);
+    merged.postings_.reserve(term_count);
+
+    // the term arrays are sorted, so they are walked side by side instead of searched term by term
+    vector<size_t> positions(segments.size(), 0);
+    while (true)
+    {
+        TermId term = numeric_limits<TermId>::max();
+        bool has_terms = false;
+        for (size_t i = 0; i < segments.size(); ++i)
+        {
+            if (positions[i] < segments[i]->terms_.size())
+            {
+                term = min(term, segments[i]->terms_[positions[i]]);
+                has_terms = true;
+            }
+        }
+        if (!has_terms)
+        {
+            break;
+        }
+        // segments cover adjacent document ranges, so appending them in order keeps the list sorted
+        PostingList merged_postings;
+        for (size_t i = 0; i < segments.size(); ++i)
+        {
+            if (positions[i] < segments[i]->terms_.size() && segments[i]->terms_[positions[i]] == term)
+            {
+                merged_postings.Append(segments[i]->postings_[positions[i]++]);
+            }
+        }
+        merged_postings.ShrinkToFit();
+        merged.terms_.push_back(term);
+        merged.postings_.push_back(move(merged_postings));
+    }
+    merged.terms_.shrink_to_fit();
+    merged.postings_.shrink_to_fit();
+    merged.is_sealed_ = true;
+    return merged;
+}
+
+TermPostings::Cursor::Cursor(const TermPostings &postings)
+    : postings_(&postings), cursor_(postings.lists_.empty() ? PostingList::GetEmpty() : *postings.lists_.front())
+{
+}
+
+bool TermPostings::Cursor::Seek(uint32_t document_index)
+{
+    // lists ending before the target are skipped without decoding a block
+    if (list_ + 1 < postings_->lists_.size() && postings_->lists_[list_]->GetLastDocumentIndex() < document_index)
+    {
+        do
+        {
+            ++list_;
+        } while (list_ + 1 < postings_->lists_.size() && postings_->lists_[list_]->GetLastDocumentIndex() < document_index);
+        cursor_ = PostingList::Cursor(*postings_->lists_[list_]);
+    }
+    return cursor_.Seek(document_index);
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include "posting_list.h"
+#include "term_dictionary.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+// Posting lists of the documents in [first, end) of the document index space. Documents
+// are appended to one mutable segment; once sealed, a segment keeps its terms in a sorted
+// array next to the lists and is only read, so it can be merged in the background. Merged
+// segments are built list by list and keep no spare capacity.
+class IndexSegment
+{
+public:
+    using TermId = TermDictionary::TermId;
+
+    explicit IndexSegment(std::uint32_t first_document_index);
+
+    // sealed segment from lists indexed by term, empty lists are dropped
+    IndexSegment(std::uint32_t first_document_index, std::uint32_t end_document_index,
+                 std::vector<PostingList> term_postings);
+
+    // document_index must be past every document already in the segment
+    void Append(TermId term, std::uint32_t document_index, std::uint32_t term_count);
+
+    // documents without terms add no postings but still belong to the segment
+    void ExtendTo(std::uint32_t end_document_index);
+
+    // seals the segment and returns the mutable one that follows it, which takes over the term table
+    IndexSegment Seal(std::uint32_t next_first_document_index);
+
+    const PostingList *FindPostings(TermId term) const;
+
+    std::uint32_t GetFirstDocumentIndex() const
+    {
+        return first_document_index_;
+    }
+
+    std::uint32_t GetEndDocumentIndex() const
+    {
+        return end_document_index_;
+    }
+
+    std::uint32_t GetDocumentCount() const
+    {
+        return end_document_index_ - first_document_index_;
+    }
+
+    // lists in term order once the segment is sealed
+    template <typename Function>
+    void ForEachTerm(Function function) const;
+
+    std::size_t GetMemoryUsage() const;
+
+    // segments must be sealed and adjacent, in document order
+    static IndexSegment Merge(const std::vector<std::shared_ptr<const IndexSegment>> &segments);
+
+private:
+    static constexpr std::uint32_t NO_POSITION = std::numeric_limits<std::uint32_t>::max();
+
+    std::uint32_t first_document_index_;
+    std::uint32_t end_document_index_;
+    std::vector<TermId> terms_;
+    std::vector<PostingList> postings_;
+    // positions in terms_ by term while the segment is mutable, handed on when it is sealed
+    std::vector<std::uint32_t> term_positions_;
+    bool is_sealed_ = false;
+};
+
+template <typename Function>
+void IndexSegment::ForEachTerm(Function function) const
+{
+    for (std::size_t i = 0; i < terms_.size(); ++i)
+    {
+        function(terms_[i], postings_[i]);
+    }
+}
+
+// postings of one term across segments, read in document order as one list
+class TermPostings
+{
+public:
+    class Cursor
+    {
+    public:
+        explicit Cursor(const TermPostings &postings);
+
+        bool IsEnd() const
+        {
+            return cursor_.IsEnd();
+        }
+
+        std::uint32_t GetDocumentIndex() const
+        {
+            return cursor_.GetDocumentIndex();
+        }
+
+        std::uint32_t GetTermCount() const
+        {
+            return cursor_.GetTermCount();
+        }
+
+        void Next()
+        {
+            cursor_.Next();
+            if (cursor_.IsEnd() && list_ + 1 < postings_->lists_.size())
+            {
+                cursor_ = PostingList::Cursor(*postings_->lists_[++list_]);
+            }
+        }
+
+        // moves to the first posting not less than document_index, reports an exact hit
+        bool Seek(std::uint32_t document_index);
+
+    private:
+        const TermPostings *postings_;
+        std::size_t list_ = 0;
+        PostingList::Cursor cursor_;
+    };
+
+    void Add(const PostingList *postings)
+    {
+        if (postings != nullptr && !postings->empty())
+        {
+            lists_.push_back(postings);
+            size_ += postings->size();
+        }
+    }
+
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    // the postings must not be empty
+    std::uint32_t GetLastDocumentIndex() const
+    {
+        return lists_.back()->GetLastDocumentIndex();
+    }
+
+    Cursor GetCursor() const
+    {
+        return Cursor(*this);
+    }
+
+    template <typename Function>
+    void ForEach(Function function) const
+    {
+        for (const PostingList *postings : lists_)
+        {
+            postings->ForEach(function);
+        }
+    }
+
+private:
+    std::vector<const PostingList *> lists_;
+    std::size_t size_ = 0;
+};
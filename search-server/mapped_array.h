@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+// Array of trivially copyable elements that either owns them or refers to
+// read-only memory owned elsewhere (a mapped snapshot). The first mutation
+// copies referenced elements into owned storage.
+template <typename T>
+class MappedArray
+{
+public:
+    static_assert(std::is_trivially_copyable_v<T>, "MappedArray supports only trivially copyable elements");
+
+    MappedArray() = default;
+
+    MappedArray(const T *data, std::size_t size)
+        : view_data_(data), view_size_(size), is_view_(true)
+    {
+    }
+
+    const T *data() const
+    {
+        return is_view_ ? view_data_ : owned_.data();
+    }
+
+    std::size_t size() const
+    {
+        return is_view_ ? view_size_ : owned_.size();
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    const T &operator[](std::size_t index) const
+    {
+        return data()[index];
+    }
+
+    const T &back() const
+    {
+        return data()[size() - 1];
+    }
+
+    const T *begin() const
+    {
+        return data();
+    }
+
+    const T *end() const
+    {
+        return data() + size();
+    }
+
+    std::vector<T> &Mutable()
+    {
+        if (is_view_)
+        {
+            owned_.assign(view_data_, view_data_ + view_size_);
+            is_view_ = false;
+        }
+        return owned_;
+    }
+
+    bool IsView() const
+    {
+        return is_view_;
+    }
+
+    // mapped memory is not counted, it belongs to the page cache
+    std::size_t GetMemoryUsage() const
+    {
+        return owned_.capacity() * sizeof(T);
+    }
+
+private:
+    std::vector<T> owned_;
+    const T *view_data_ = nullptr;
+    std::size_t view_size_ = 0;
+    bool is_view_ = false;
+};
@@ -0,0 +1,302 @@
+#include "metrics.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+using namespace std;
+
+namespace
+{
+    const char *const STAGE_NAMES[QUERY_STAGE_COUNT] = {"parse", "posting_traversal", "minus_words", "filtering", "sorting", "materialization"};
+
+    const char *const COUNTER_NAMES[METRIC_COUNTER_COUNT] = {"queries", "postings_scanned", "documents_scored"};
+
+    const char *const COUNTER_HELP[METRIC_COUNTER_COUNT] = {"Queries answered.", "Postings read by queries.",
+                                                           "Documents queries computed a relevance for."};
+
+    // bucket bounds of the exported histogram, in seconds
+    const double EXPORTED_BOUNDS[] = {1e-6, 2e-6, 5e-6, 1e-5, 2e-5, 5e-5, 1e-4, 2e-4, 5e-4, 1e-3,
+                                      2e-3, 5e-3, 1e-2, 2e-2, 5e-2, 1e-1, 2e-1, 5e-1, 1.0, 2.0, 5.0, 10.0};
+
+    const double EXPORTED_QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+}
+
+string_view GetQueryStageName(QueryStage stage)
+{
+    return STAGE_NAMES[static_cast<size_t>(stage)];
+}
+
+size_t HistogramSnapshot::GetBucket(uint64_t value)
+{
+    if (value < SUB_BUCKET_COUNT)
+    {
+        return value;
+    }
+    const size_t shift = 63 - __builtin_clzll(value) - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKET_COUNT + ((value >> shift) & (SUB_BUCKET_COUNT - 1));
+}
+
+uint64_t HistogramSnapshot::GetBucketUpperBound(size_t bucket)
+{
+    if (bucket < SUB_BUCKET_COUNT)
+    {
+        return bucket;
+    }
+    const size_t shift = bucket / SUB_BUCKET_COUNT - 1;
+    const uint64_t lower = static_cast<uint64_t>(SUB_BUCKET_COUNT + bucket % SUB_BUCKET_COUNT) << shift;
+    return lower + ((uint64_t{1} << shift) - 1);
+}
+
+uint64_t HistogramSnapshot::GetQuantile(double quantile) const
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    const auto rank = static_cast<uint64_t>(quantile * (count - 1));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < counts.size(); ++bucket)
+    {
+        seen += counts[bucket];
+        if (seen > rank)
+        {
+            return GetBucketUpperBound(bucket);
+        }
+    }
+    return GetBucketUpperBound(counts.size() - 1);
+}
+
+#ifndef SEARCH_SERVER_NO_METRICS
+
+namespace
+{
+    // written by one thread at a time, so updates are a relaxed load and store, not a locked add
+    void Increase(atomic<uint64_t> &value, uint64_t delta)
+    {
+        value.store(value.load(memory_order_relaxed) + delta, memory_order_relaxed);
+    }
+
+    struct HistogramShard
+    {
+        array<atomic<uint64_t>, HistogramSnapshot::BUCKET_COUNT> counts{};
+        atomic<uint64_t> count = 0;
+        atomic<uint64_t> sum = 0;
+    };
+
+    struct MetricsShard
+    {
+        array<HistogramShard, QUERY_STAGE_COUNT> stages;
+        array<atomic<uint64_t>, METRIC_COUNTER_COUNT> counters{};
+    };
+
+    // Shards are never freed: one that a finished thread released keeps its values and goes to
+    // the next new thread, so threads started per batch do not pile up shards
+    struct MetricsRegistry
+    {
+        mutex shards_mutex;
+        vector<unique_ptr<MetricsShard>> shards;
+        vector<MetricsShard *> free_shards;
+    };
+
+    // leaked on purpose, threads may still record while static objects are destroyed
+    MetricsRegistry &GetRegistry()
+    {
+        static MetricsRegistry *registry = new MetricsRegistry;
+        return *registry;
+    }
+
+    class ShardHandle
+    {
+    public:
+        ShardHandle()
+        {
+            MetricsRegistry &registry = GetRegistry();
+            lock_guard guard(registry.shards_mutex);
+            if (registry.free_shards.empty())
+            {
+                shard_ = registry.shards.emplace_back(make_unique<MetricsShard>()).get();
+            }
+            else
+            {
+                shard_ = registry.free_shards.back();
+                registry.free_shards.pop_back();
+            }
+        }
+
+        ~ShardHandle()
+        {
+            MetricsRegistry &registry = GetRegistry();
+            lock_guard guard(registry.shards_mutex);
+            registry.free_shards.push_back(shard_);
+        }
+
+        MetricsShard &Get() const
+        {
+            return *shard_;
+        }
+
+    private:
+        MetricsShard *shard_;
+    };
+
+    MetricsShard &GetThreadShard()
+    {
+        thread_local ShardHandle handle;
+        return handle.Get();
+    }
+
+    template <typename Function>
+    void ForEachShard(Function function)
+    {
+        MetricsRegistry &registry = GetRegistry();
+        lock_guard guard(registry.shards_mutex);
+        for (const auto &shard : registry.shards)
+        {
+            function(*shard);
+        }
+    }
+}
+
+void RecordQueryStage(QueryStage stage, uint64_t nanoseconds)
+{
+    HistogramShard &histogram = GetThreadShard().stages[static_cast<size_t>(stage)];
+    Increase(histogram.counts[HistogramSnapshot::GetBucket(nanoseconds)], 1);
+    Increase(histogram.count, 1);
+    Increase(histogram.sum, nanoseconds);
+}
+
+void AddMetricCounter(MetricCounter counter, uint64_t value)
+{
+    Increase(GetThreadShard().counters[static_cast<size_t>(counter)], value);
+}
+
+HistogramSnapshot GetQueryStageHistogram(QueryStage stage)
+{
+    HistogramSnapshot snapshot;
+    ForEachShard([&snapshot, stage](const MetricsShard &shard)
+                 {
+                     const HistogramShard &histogram = shard.stages[static_cast<size_t>(stage)];
+                     for (size_t bucket = 0; bucket < HistogramSnapshot::BUCKET_COUNT; ++bucket)
+                     {
+                         snapshot.counts[bucket] += histogram.counts[bucket].load(memory_order_relaxed);
+                     }
+                     snapshot.count += histogram.count.load(memory_order_relaxed);
+                     snapshot.sum += histogram.sum.load(memory_order_relaxed); });
+    return snapshot;
+}
+
+uint64_t GetMetricCounter(MetricCounter counter)
+{
+    uint64_t value = 0;
+    ForEachShard([&value, counter](const MetricsShard &shard)
+                 { value += shard.counters[static_cast<size_t>(counter)].load(memory_order_relaxed); });
+    return value;
+}
+
+void ResetMetrics()
+{
+    ForEachShard([](MetricsShard &shard)
+                 {
+                     for (HistogramShard &histogram : shard.stages)
+                     {
+                         for (auto &count : histogram.counts)
+                         {
+                             count.store(0, memory_order_relaxed);
+                         }
+                         histogram.count.store(0, memory_order_relaxed);
+                         histogram.sum.store(0, memory_order_relaxed);
+                     }
+                     for (auto &counter : shard.counters)
+                     {
+                         counter.store(0, memory_order_relaxed);
+                     } });
+}
+
+#else
+
+HistogramSnapshot GetQueryStageHistogram(QueryStage)
+{
+    return {};
+}
+
+uint64_t GetMetricCounter(MetricCounter)
+{
+    return 0;
+}
+
+void ResetMetrics()
+{
+}
+
+#endif
+
+void WriteMetrics(ostream &output)
+{
+    const auto flags = output.flags();
+    const auto precision = output.precision();
+    output << setprecision(9);
+    output << "# HELP search_server_query_stage_duration_seconds Time queries spent in a stage.\n"
+           << "# TYPE search_server_query_stage_duration_seconds histogram\n";
+    vector<HistogramSnapshot> histograms;
+    for (size_t stage = 0; stage < QUERY_STAGE_COUNT; ++stage)
+    {
+        const HistogramSnapshot &histogram = histograms.emplace_back(GetQueryStageHistogram(static_cast<QueryStage>(stage)));
+        // a bucket goes under the first bound its upper end fits, so counts near a bound lean up by at most 12.5%
+        uint64_t cumulative_count = 0;
+        size_t bucket = 0;
+        for (const double bound : EXPORTED_BOUNDS)
+        {
+            for (; bucket < histogram.counts.size() && HistogramSnapshot::GetBucketUpperBound(bucket) <= bound * 1e9; ++bucket)
+            {
+                cumulative_count += histogram.counts[bucket];
+            }
+            output << "search_server_query_stage_duration_seconds_bucket{stage=\"" << STAGE_NAMES[stage] << "\",le=\"" << bound
+                   << "\"} " << cumulative_count << '\n';
+        }
+        output << "search_server_query_stage_duration_seconds_bucket{stage=\"" << STAGE_NAMES[stage] << "\",le=\"+Inf\"} "
+               << histogram.count << '\n'
+               << "search_server_query_stage_duration_seconds_sum{stage=\"" << STAGE_NAMES[stage] << "\"} "
+               << histogram.sum / 1e9 << '\n'
+               << "search_server_query_stage_duration_seconds_count{stage=\"" << STAGE_NAMES[stage] << "\"} "
+               << histogram.count << '\n';
+    }
+    output << "# HELP search_server_query_stage_duration_quantile_seconds Stage duration quantiles, within 12.5%.\n"
+           << "# TYPE search_server_query_stage_duration_quantile_seconds gauge\n";
+    for (size_t stage = 0; stage < QUERY_STAGE_COUNT; ++stage)
+    {
+        for (const double quantile : EXPORTED_QUANTILES)
+        {
+            output << "search_server_query_stage_duration_quantile_seconds{stage=\"" << STAGE_NAMES[stage] << "\",quantile=\""
+                   << quantile << "\"} " << histograms[stage].GetQuantile(quantile) / 1e9 << '\n';
+        }
+    }
+    for (size_t counter = 0; counter < METRIC_COUNTER_COUNT; ++counter)
+    {
+        output << "# HELP search_server_" << COUNTER_NAMES[counter] << "_total " << COUNTER_HELP[counter] << '\n'
+               << "# TYPE search_server_" << COUNTER_NAMES[counter] << "_total counter\n"
+               << "search_server_" << COUNTER_NAMES[counter] << "_total " << GetMetricCounter(static_cast<MetricCounter>(counter)) << '\n';
+    }
+    output.flags(flags);
+    output.precision(precision);
+}
+
+void WriteMetrics(const string &path)
+{
+    const string temporary_path = path + ".tmp";
+    {
+        ofstream output(temporary_path);
+        WriteMetrics(output);
+        if (!output.flush())
+        {
+            throw runtime_error("Cannot write metrics to " + temporary_path);
+        }
+    }
+    if (rename(temporary_path.c_str(), path.c_str()) != 0)
+    {
+        throw runtime_error("Cannot replace " + path);
+    }
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Query metrics: stage latencies and work counters, kept per thread and merged when read.
+// Building with -DSEARCH_SERVER_NO_METRICS removes them: recording compiles to nothing and
+// reading returns zeros.
+#ifdef SEARCH_SERVER_NO_METRICS
+constexpr bool METRICS_ENABLED = false;
+#else
+constexpr bool METRICS_ENABLED = true;
+#endif
+
+// the parallel engine times every range of documents it scores as a separate sample
+enum class QueryStage
+{
+    // splitting, validating and looking up query words
+    PARSE,
+    // reading plus-word posting lists and summing relevance; MaxScore records its whole loop here
+    POSTING_TRAVERSAL,
+    MINUS_WORDS,
+    // dropping unmatched and removed documents and offering the rest to the top
+    FILTERING,
+    SORTING,
+    // handing the results out, query cache lookups and inserts included
+    MATERIALIZATION,
+};
+
+const std::size_t QUERY_STAGE_COUNT = 6;
+
+// snake case, as in the exported labels
+std::string_view GetQueryStageName(QueryStage stage);
+
+enum class MetricCounter
+{
+    QUERIES,
+    POSTINGS_SCANNED,
+    DOCUMENTS_SCORED,
+};
+
+const std::size_t METRIC_COUNTER_COUNT = 3;
+
+// Log-linear buckets in the manner of HdrHistogram: values below 8 are exact, above that every
+// power of two is split into 8 buckets, so a bucket is within 12.5% of any value in it.
+struct HistogramSnapshot
+{
+    static constexpr std::size_t SUB_BUCKET_BITS = 3;
+    static constexpr std::size_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    static constexpr std::size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    std::vector<std::uint64_t> counts = std::vector<std::uint64_t>(BUCKET_COUNT);
+    std::uint64_t count = 0;
+    std::uint64_t sum = 0;
+
+    static std::size_t GetBucket(std::uint64_t value);
+
+    // the largest value that falls into the bucket
+    static std::uint64_t GetBucketUpperBound(std::size_t bucket);
+
+    // upper bound of the bucket holding the quantile, 0 when nothing is recorded
+    std::uint64_t GetQuantile(double quantile) const;
+};
+
+#ifndef SEARCH_SERVER_NO_METRICS
+
+void RecordQueryStage(QueryStage stage, std::uint64_t nanoseconds);
+
+void AddMetricCounter(MetricCounter counter, std::uint64_t value);
+
+#else
+
+inline void RecordQueryStage(QueryStage, std::uint64_t)
+{
+}
+
+inline void AddMetricCounter(MetricCounter, std::uint64_t)
+{
+}
+
+#endif
+
+// merged over all threads, in nanoseconds
+HistogramSnapshot GetQueryStageHistogram(QueryStage stage);
+
+std::uint64_t GetMetricCounter(MetricCounter counter);
+
+// values recorded while the reset runs may survive it
+void ResetMetrics();
+
+// Prometheus text exposition format: a histogram of stage durations in seconds, their
+// quantiles as gauges, and the counters
+void WriteMetrics(std::ostream &output);
+
+// written to path.tmp and renamed, so a scraper never reads a half-written file
+void WriteMetrics(const std::string &path);
+
+// measures from construction to Stop() or destruction, whichever comes first
+class QueryStageTimer
+{
+public:
+    explicit QueryStageTimer(QueryStage stage)
+    {
+        if constexpr (METRICS_ENABLED)
+        {
+            stage_ = stage;
+            start_ = std::chrono::steady_clock::now();
+        }
+    }
+
+    QueryStageTimer(const QueryStageTimer &) = delete;
+
+    QueryStageTimer &operator=(const QueryStageTimer &) = delete;
+
+    ~QueryStageTimer()
+    {
+        Stop();
+    }
+
+    void Stop()
+    {
+        if constexpr (METRICS_ENABLED)
+        {
+            if (is_running_)
+            {
+                is_running_ = false;
+                RecordQueryStage(stage_, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count());
+            }
+        }
+    }
+
+private:
+    QueryStage stage_ = QueryStage::PARSE;
+    std::chrono::steady_clock::time_point start_;
+    bool is_running_ = METRICS_ENABLED;
+};
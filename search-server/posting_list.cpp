@@ -0,0 +1,398 @@
+#include "posting_list.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+    constexpr size_t LANE_COUNT = 4;
+    constexpr size_t ROW_COUNT = PostingList::BLOCK_SIZE / LANE_COUNT;
+
+    uint8_t GetBitWidth(const uint32_t *values)
+    {
+        uint32_t bits_union = 0;
+        for (size_t i = 0; i < PostingList::BLOCK_SIZE; ++i)
+        {
+            bits_union |= values[i];
+        }
+        uint8_t bits = 0;
+        for (; bits_union != 0; bits_union >>= 1)
+        {
+            ++bits;
+        }
+        return bits;
+    }
+
+    // value 4 * row + lane goes to bits [row * bits, (row + 1) * bits) of lane `lane`
+    void Pack(const uint32_t *values, uint8_t bits, vector<uint32_t> &packed)
+    {
+        if (bits == 0)
+        {
+            return;
+        }
+        const size_t offset = packed.size();
+        packed.resize(offset + LANE_COUNT * bits, 0);
+        uint32_t *words = packed.data() + offset;
+        for (size_t row = 0; row < ROW_COUNT; ++row)
+        {
+            const size_t bit = row * bits;
+            const size_t word = bit / 32;
+            const size_t shift = bit % 32;
+            for (size_t lane = 0; lane < LANE_COUNT; ++lane)
+            {
+                const uint32_t value = values[row * LANE_COUNT + lane];
+                words[word * LANE_COUNT + lane] |= value << shift;
+                if (shift + bits > 32)
+                {
+                    words[(word + 1) * LANE_COUNT + lane] |= value >> (32 - shift);
+                }
+            }
+        }
+    }
+
+    void Unpack(const uint32_t *words, uint8_t bits, uint32_t *values)
+    {
+        if (bits == 0)
+        {
+            fill(values, values + PostingList::BLOCK_SIZE, 0);
+            return;
+        }
+        const uint32_t mask = bits == 32 ? ~0u : (1u << bits) - 1;
+#ifdef __SSE2__
+        const __m128i lane_mask = _mm_set1_epi32(static_cast<int>(mask));
+        const __m128i *lanes = reinterpret_cast<const __m128i *>(words);
+        __m128i *rows = reinterpret_cast<__m128i *>(values);
+        for (size_t row = 0; row < ROW_COUNT; ++row)
+        {
+            const size_t bit = row * bits;
+            const size_t word = bit / 32;
+            const int shift = static_cast<int>(bit % 32);
+            __m128i value = _mm_srl_epi32(_mm_loadu_si128(lanes + word), _mm_cvtsi32_si128(shift));
+            if (shift + bits > 32)
+            {
+                value = _mm_or_si128(value, _mm_sll_epi32(_mm_loadu_si128(lanes + word + 1), _mm_cvtsi32_si128(32 - shift)));
+            }
+            _mm_storeu_si128(rows + row, _mm_and_si128(value, lane_mask));
+        }
+#else
+        for (size_t row = 0; row < ROW_COUNT; ++row)
+        {
+            const size_t bit = row * bits;
+            const size_t word = bit / 32;
+            const size_t shift = bit % 32;
+            for (size_t lane = 0; lane < LANE_COUNT; ++lane)
+            {
+                uint32_t value = words[word * LANE_COUNT + lane] >> shift;
+                if (shift + bits > 32)
+                {
+                    value |= words[(word + 1) * LANE_COUNT + lane] << (32 - shift);
+                }
+                values[row * LANE_COUNT + lane] = value & mask;
+            }
+        }
+#endif
+    }
+
+    // turns deltas against the value four places back into absolute values
+    void PrefixSum(uint32_t first, uint32_t *values)
+    {
+#ifdef __SSE2__
+        __m128i previous = _mm_set1_epi32(static_cast<int>(first));
+        __m128i *rows = reinterpret_cast<__m128i *>(values);
+        for (size_t row = 0; row < ROW_COUNT; ++row)
+        {
+            previous = _mm_add_epi32(previous, _mm_loadu_si128(rows + row));
+            _mm_storeu_si128(rows + row, previous);
+        }
+#else
+        for (size_t lane = 0; lane < LANE_COUNT; ++lane)
+        {
+            values[lane] += first;
+        }
+        for (size_t i = LANE_COUNT; i < PostingList::BLOCK_SIZE; ++i)
+        {
+            values[i] += values[i - LANE_COUNT];
+        }
+#endif
+    }
+}
+
+PostingList::Cursor::Cursor(const PostingList &postings)
+    : postings_(&postings)
+{
+    LoadBlock(0);
+}
+
+bool PostingList::Cursor::Seek(uint32_t document_index)
+{
+    if (IsEnd())
+    {
+        return false;
+    }
+    if (document_indexes_[size_ - 1] < document_index)
+    {
+        if (block_ >= postings_->blocks_.size())
+        {
+            position_ = size_;
+            return false;
+        }
+        const auto first = postings_->blocks_.begin() + block_ + 1;
+        const auto it = partition_point(first, postings_->blocks_.end(), [document_index](const Block &block)
+                                        { return block.last_document_index < document_index; });
+        LoadBlock(it - postings_->blocks_.begin());
+        if (IsEnd())
+        {
+            return false;
+        }
+    }
+    position_ = lower_bound(document_indexes_.begin() + position_, document_indexes_.begin() + size_, document_index) - document_indexes_.begin();
+    return position_ != size_ && document_indexes_[position_] == document_index;
+}
+
+void PostingList::Cursor::LoadBlock(size_t block)
+{
+    block_ = block;
+    position_ = 0;
+    if (block < postings_->blocks_.size())
+    {
+        size_ = postings_->DecodeBlock(block, document_indexes_.data(), term_counts_.data());
+    }
+    else if (block == postings_->blocks_.size())
+    {
+        size_ = postings_->tail_.size();
+        for (size_t i = 0; i < size_; ++i)
+        {
+            document_indexes_[i] = postings_->tail_[i].document_index;
+            term_counts_[i] = postings_->tail_[i].term_count;
+        }
+    }
+    else
+    {
+        size_ = 0;
+    }
+}
+
+void PostingList::Append(uint32_t document_index, uint32_t term_count)
+{
+    tail_.Mutable().push_back({document_index, term_count});
+    ++size_;
+    if (tail_.size() == BLOCK_SIZE)
+    {
+        EncodeTail();
+    }
+}
+
+void PostingList::Append(const PostingList &postings)
+{
+    if (postings.blocks_.empty() && tail_.size() + postings.size_ < BLOCK_SIZE)
+    {
+        tail_.Mutable().insert(tail_.Mutable().end(), postings.tail_.begin(), postings.tail_.end());
+        size_ += postings.size_;
+        return;
+    }
+    if (postings.blocks_.empty())
+    {
+        for (const auto [document_index, term_count] : postings.tail_)
+        {
+            Append(document_index, term_count);
+        }
+        return;
+    }
+    // the tail becomes a short block, so the blocks of postings stay aligned and are copied as they are
+    if (!tail_.empty())
+    {
+        EncodeTail();
+    }
+    vector<Block> &blocks = blocks_.Mutable();
+    vector<uint32_t> &packed = packed_.Mutable();
+    const auto offset = static_cast<uint32_t>(packed.size());
+    for (Block block : postings.blocks_)
+    {
+        block.offset += offset;
+        blocks.push_back(block);
+    }
+    packed.insert(packed.end(), postings.packed_.begin(), postings.packed_.end());
+    tail_.Mutable().assign(postings.tail_.begin(), postings.tail_.end());
+    size_ += postings.size_;
+}
+
+bool PostingList::Contains(uint32_t document_index) const
+{
+    const size_t block = FindBlock(document_index);
+    if (block == blocks_.size())
+    {
+        return binary_search(tail_.begin(), tail_.end(), Posting{document_index, 0}, [](const Posting &lhs, const Posting &rhs)
+                             { return lhs.document_index < rhs.document_index; });
+    }
+    if (blocks_[block].first_document_index > document_index)
+    {
+        return false;
+    }
+    array<uint32_t, BLOCK_SIZE> document_indexes;
+    array<uint32_t, BLOCK_SIZE> term_counts;
+    const size_t block_size = DecodeBlock(block, document_indexes.data(), term_counts.data());
+    return binary_search(document_indexes.begin(), document_indexes.begin() + block_size, document_index);
+}
+
+void PostingList::EncodeTail()
+{
+    array<uint32_t, BLOCK_SIZE> document_indexes;
+    array<uint32_t, BLOCK_SIZE> term_counts;
+    for (size_t i = 0; i < tail_.size(); ++i)
+    {
+        document_indexes[i] = tail_[i].document_index;
+        term_counts[i] = tail_[i].term_count;
+    }
+    blocks_.Mutable().push_back(EncodeBlock(document_indexes.data(), term_counts.data(), tail_.size(), packed_.Mutable()));
+    tail_.Mutable().clear();
+}
+
+size_t PostingList::GetMemoryUsage() const
+{
+    return sizeof(*this) + blocks_.GetMemoryUsage() + packed_.GetMemoryUsage() + tail_.GetMemoryUsage();
+}
+
+void PostingList::ShrinkToFit()
+{
+    if (!blocks_.IsView())
+    {
+        blocks_.Mutable().shrink_to_fit();
+    }
+    if (!packed_.IsView())
+    {
+        packed_.Mutable().shrink_to_fit();
+    }
+    if (!tail_.IsView())
+    {
+        tail_.Mutable().shrink_to_fit();
+    }
+}
+
+const PostingList &PostingList::GetEmpty()
+{
+    static const PostingList empty;
+    return empty;
+}
+
+void PostingList::SaveSnapshot(const vector<PostingList> &lists, SnapshotWriter &writer)
+{
+    vector<Layout> layouts;
+    layouts.reserve(lists.size());
+    uint64_t block_begin = 0;
+    uint64_t packed_begin = 0;
+    uint64_t tail_begin = 0;
+    for (const PostingList &list : lists)
+    {
+        layouts.push_back({block_begin, packed_begin, tail_begin, static_cast<uint32_t>(list.blocks_.size()),
+                           static_cast<uint32_t>(list.packed_.size()), static_cast<uint32_t>(list.tail_.size()), static_cast<uint32_t>(list.size_)});
+        block_begin += list.blocks_.size();
+        packed_begin += list.packed_.size();
+        tail_begin += list.tail_.size();
+    }
+    writer.BeginSection(SnapshotSection::POSTING_LAYOUTS);
+    writer.WriteArray(layouts.data(), layouts.size());
+    writer.BeginSection(SnapshotSection::POSTING_BLOCKS);
+    for (const PostingList &list : lists)
+    {
+        writer.WriteArray(list.blocks_.data(), list.blocks_.size());
+    }
+    writer.BeginSection(SnapshotSection::POSTING_PACKED);
+    for (const PostingList &list : lists)
+    {
+        writer.WriteArray(list.packed_.data(), list.packed_.size());
+    }
+    writer.BeginSection(SnapshotSection::POSTING_TAILS);
+    for (const PostingList &list : lists)
+    {
+        writer.WriteArray(list.tail_.data(), list.tail_.size());
+    }
+}
+
+vector<PostingList> PostingList::LoadSnapshot(const SnapshotReader &reader)
+{
+    const auto [layouts, list_count] = reader.GetArray<Layout>(SnapshotSection::POSTING_LAYOUTS);
+    const auto [blocks, block_count] = reader.GetArray<Block>(SnapshotSection::POSTING_BLOCKS);
+    const auto [packed, packed_count] = reader.GetArray<uint32_t>(SnapshotSection::POSTING_PACKED);
+    const auto [tails, tail_count] = reader.GetArray<Posting>(SnapshotSection::POSTING_TAILS);
+    vector<PostingList> lists(list_count);
+    for (size_t i = 0; i < list_count; ++i)
+    {
+        const Layout &layout = layouts[i];
+        bool is_valid = layout.block_begin <= block_count && layout.block_count <= block_count - layout.block_begin &&
+                        layout.packed_begin <= packed_count && layout.packed_count <= packed_count - layout.packed_begin &&
+                        layout.tail_begin <= tail_count && layout.tail_count <= tail_count - layout.tail_begin &&
+                        layout.tail_count < BLOCK_SIZE;
+        // decoding trusts block headers, so every packed range is checked once here
+        size_t posting_count = layout.tail_count;
+        for (size_t block = 0; is_valid && block < layout.block_count; ++block)
+        {
+            const Block &info = blocks[layout.block_begin + block];
+            is_valid = info.size > 0 && info.size <= BLOCK_SIZE && info.document_bits <= 32 && info.count_bits <= 32 &&
+                       info.offset + LANE_COUNT * (info.document_bits + info.count_bits) <= layout.packed_count;
+            posting_count += info.size;
+        }
+        if (!is_valid || posting_count != layout.size)
+        {
+            throw runtime_error("Snapshot posting lists are corrupted");
+        }
+        PostingList &list = lists[i];
+        list.blocks_ = MappedArray<Block>(blocks + layout.block_begin, layout.block_count);
+        list.packed_ = MappedArray<uint32_t>(packed + layout.packed_begin, layout.packed_count);
+        list.tail_ = MappedArray<Posting>(tails + layout.tail_begin, layout.tail_count);
+        list.size_ = layout.size;
+    }
+    return lists;
+}
+
+size_t PostingList::FindBlock(uint32_t document_index) const
+{
+    return partition_point(blocks_.begin(), blocks_.end(), [document_index](const Block &block)
+                           { return block.last_document_index < document_index; }) -
+           blocks_.begin();
+}
+
+size_t PostingList::DecodeBlock(size_t block, uint32_t *document_indexes, uint32_t *term_counts) const
+{
+    const Block &info = blocks_[block];
+    const uint32_t *words = packed_.data() + info.offset;
+    Unpack(words, info.document_bits, document_indexes);
+    PrefixSum(info.first_document_index, document_indexes);
+    Unpack(words + LANE_COUNT * info.document_bits, info.count_bits, term_counts);
+    for (size_t i = 0; i < info.size; ++i)
+    {
+        ++term_counts[i];
+    }
+    return info.size;
+}
+
+PostingList::Block PostingList::EncodeBlock(const uint32_t *document_indexes, const uint32_t *term_counts, size_t size,
+                                            vector<uint32_t> &packed) const
+{
+    // pad partial blocks by repeating the last posting, which packs as zero deltas
+    array<uint32_t, BLOCK_SIZE> deltas;
+    array<uint32_t, BLOCK_SIZE> counts;
+    const uint32_t first = document_indexes[0];
+    for (size_t i = 0; i < BLOCK_SIZE; ++i)
+    {
+        const uint32_t current = document_indexes[min(i, size - 1)];
+        const uint32_t previous = i < LANE_COUNT ? first : document_indexes[min(i - LANE_COUNT, size - 1)];
+        deltas[i] = current - previous;
+        counts[i] = i < size ? term_counts[i] - 1 : 0;
+    }
+    Block block;
+    block.first_document_index = first;
+    block.last_document_index = document_indexes[size - 1];
+    block.offset = static_cast<uint32_t>(packed.size());
+    block.document_bits = GetBitWidth(deltas.data());
+    block.count_bits = GetBitWidth(counts.data());
+    block.size = static_cast<uint16_t>(size);
+    Pack(deltas.data(), block.document_bits, packed);
+    Pack(counts.data(), block.count_bits, packed);
+    return block;
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include "mapped_array.h"
+#include "snapshot.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Posting
+{
+    std::uint32_t document_index;
+    std::uint32_t term_count;
+};
+
+// Document-index-sorted postings. Full blocks of BLOCK_SIZE postings are stored
+// BP128-style: document indexes as deltas against the posting four places back
+// and term counts, both bit-packed in four interleaved 32-bit lanes, so a block
+// is unpacked and prefix-summed with 128-bit SIMD operations. The most recent
+// postings stay uncompressed in a tail until they fill a block.
+class PostingList
+{
+public:
+    static constexpr std::size_t BLOCK_SIZE = 128;
+
+    // where one list lives inside the shared posting sections of a snapshot
+    struct Layout
+    {
+        std::uint64_t block_begin;
+        std::uint64_t packed_begin;
+        std::uint64_t tail_begin;
+        std::uint32_t block_count;
+        std::uint32_t packed_count;
+        std::uint32_t tail_count;
+        std::uint32_t size;
+    };
+
+    class Cursor
+    {
+    public:
+        explicit Cursor(const PostingList &postings);
+
+        bool IsEnd() const
+        {
+            return position_ == size_;
+        }
+
+        std::uint32_t GetDocumentIndex() const
+        {
+            return document_indexes_[position_];
+        }
+
+        std::uint32_t GetTermCount() const
+        {
+            return term_counts_[position_];
+        }
+
+        void Next()
+        {
+            if (++position_ == size_)
+            {
+                LoadBlock(block_ + 1);
+            }
+        }
+
+        // moves to the first posting not less than document_index, reports an exact hit
+        bool Seek(std::uint32_t document_index);
+
+    private:
+        const PostingList *postings_;
+        std::size_t block_ = 0;
+        std::size_t position_ = 0;
+        std::size_t size_ = 0;
+        std::array<std::uint32_t, BLOCK_SIZE> document_indexes_;
+        std::array<std::uint32_t, BLOCK_SIZE> term_counts_;
+
+        void LoadBlock(std::size_t block);
+    };
+
+    // document_index must be greater than every index already in the list
+    void Append(std::uint32_t document_index, std::uint32_t term_count);
+
+    // every posting must come after the ones already in the list; whole blocks are copied without decoding
+    void Append(const PostingList &postings);
+
+    bool Contains(std::uint32_t document_index) const;
+
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    // the list must not be empty
+    std::uint32_t GetLastDocumentIndex() const
+    {
+        return tail_.empty() ? blocks_.back().last_document_index : tail_.back().document_index;
+    }
+
+    Cursor GetCursor() const
+    {
+        return Cursor(*this);
+    }
+
+    template <typename Function>
+    void ForEach(Function function) const;
+
+    std::size_t GetMemoryUsage() const;
+
+    // releases spare capacity of owned storage, mapped storage stays mapped
+    void ShrinkToFit();
+
+    static const PostingList &GetEmpty();
+
+    static void SaveSnapshot(const std::vector<PostingList> &lists, SnapshotWriter &writer);
+
+    // the lists refer to the mapped file and copy a part of it on the first change
+    static std::vector<PostingList> LoadSnapshot(const SnapshotReader &reader);
+
+private:
+    struct Block
+    {
+        std::uint32_t first_document_index;
+        std::uint32_t last_document_index;
+        std::uint32_t offset;
+        std::uint8_t document_bits;
+        std::uint8_t count_bits;
+        std::uint16_t size;
+    };
+
+    MappedArray<Block> blocks_;
+    MappedArray<std::uint32_t> packed_;
+    MappedArray<Posting> tail_;
+    std::size_t size_ = 0;
+
+    // blocks_.size() addresses the tail
+    std::size_t FindBlock(std::uint32_t document_index) const;
+
+    std::size_t DecodeBlock(std::size_t block, std::uint32_t *document_indexes, std::uint32_t *term_counts) const;
+
+    // the tail may be shorter than a block, blocks decode their own size
+    void EncodeTail();
+
+    Block EncodeBlock(const std::uint32_t *document_indexes, const std::uint32_t *term_counts, std::size_t size,
+                      std::vector<std::uint32_t> &packed) const;
+};
+
+template <typename Function>
+void PostingList::ForEach(Function function) const
+{
+    std::array<std::uint32_t, BLOCK_SIZE> document_indexes;
+    std::array<std::uint32_t, BLOCK_SIZE> term_counts;
+    for (std::size_t block = 0; block < blocks_.size(); ++block)
+    {
+        const std::size_t block_size = DecodeBlock(block, document_indexes.data(), term_counts.data());
+        for (std::size_t i = 0; i < block_size; ++i)
+        {
+            function(document_indexes[i], term_counts[i]);
+        }
+    }
+    for (const auto [document_index, term_count] : tail_)
+    {
+        function(document_index, term_count);
+    }
+}
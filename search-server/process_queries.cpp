@@ -7,6 +7,18 @@ vector<vector<Document>> ProcessQueries(
     const vector<string> &queries)
 {
     vector<vector<Document>> documents_lists(queries.size());
+    if (const auto &executor = search_server.GetExecutor())
+    {
+        // queries and the ranges inside each of them share the pool: a query waiting for its
+        // ranges runs other tasks meanwhile, so no thread is added or left idle
+        executor->ParallelFor(queries.size(), 1, [&](size_t begin, size_t end)
+                              {
+                                  for (size_t i = begin; i < end; ++i)
+                                  {
+                                      documents_lists[i] = search_server.FindTopDocuments(execution::par, queries[i]);
+                                  } });
+        return documents_lists;
+    }
     transform(execution::par, queries.begin(), queries.end(), documents_lists.begin(),
               [&search_server](const string &query)
               { return search_server.FindTopDocuments(query); });
@@ -18,10 +30,8 @@ vector<Document> ProcessQueriesJoined(
     const vector<string> &queries)
 {
     vector<Document> docs;
-
-    for (auto &vector_of_docs : ProcessQueries(search_server, queries))
-    {
-        docs.insert(docs.end(), vector_of_docs.begin(), vector_of_docs.end());
-    }
+    // results are appended as they arrive instead of being collected per query first
+    ProcessQueriesStream(search_server, queries, [&docs](size_t, vector<Document> query_docs)
+                         { docs.insert(docs.end(), query_docs.begin(), query_docs.end()); });
     return docs;
-}
\ No newline at end of file
+}
@@ -5,8 +5,18 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 #include <algorithm>
 #include <execution>
+#include <condition_variable>
+#include <exception>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
 
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer &search_server,
@@ -14,4 +24,130 @@ std::vector<std::vector<Document>> ProcessQueries(
 
 std::vector<Document> ProcessQueriesJoined(
     const SearchServer &search_server,
-    const std::vector<std::string> &queries);
\ No newline at end of file
+    const std::vector<std::string> &queries);
+
+struct QueryStreamOptions
+{
+    // threads running queries, the calling thread is one of them
+    std::size_t worker_count = std::max(1u, std::thread::hardware_concurrency());
+    // queries taken from the source whose results the sink has not got yet; when there are
+    // this many, workers stop taking queries until the sink catches up
+    std::size_t max_pending_count = 64;
+    // results go to the sink in query order, otherwise as soon as they are ready
+    bool is_ordered = true;
+};
+
+// Runs queries from a range of strings or from a generator returning std::optional of a
+// string (std::nullopt ends the stream) and passes each result to sink(index, documents)
+// as it is ready. The sink is never called concurrently. The first exception thrown by
+// the source, a query or the sink stops the stream and is rethrown once workers are done.
+template <typename QuerySource, typename ResultSink>
+void ProcessQueriesStream(const SearchServer &search_server, QuerySource &&queries, ResultSink sink,
+                          const QueryStreamOptions &options = {})
+{
+    if constexpr (!std::is_invocable_v<QuerySource &>)
+    {
+        auto it = std::begin(queries);
+        const auto last = std::end(queries);
+        ProcessQueriesStream(
+            search_server, [&it, &last]() -> std::optional<std::string_view>
+            {
+                if (it == last)
+                {
+                    return std::nullopt;
+                }
+                return std::string_view(*it++); },
+            std::move(sink), options);
+    }
+    else
+    {
+        if (options.worker_count == 0 || options.max_pending_count == 0)
+        {
+            throw std::invalid_argument("Query stream needs at least one worker and one pending query");
+        }
+        std::mutex mutex;
+        std::condition_variable has_room;
+        std::size_t next_index = 0;
+        std::size_t delivered_count = 0;
+        bool is_exhausted = false;
+        bool is_delivering = false;
+        std::exception_ptr error;
+        // finished results the sink has not got yet, by query index
+        std::map<std::size_t, std::vector<Document>> completed;
+
+        const auto work = [&]()
+        {
+            std::unique_lock lock(mutex);
+            try
+            {
+                while (true)
+                {
+                    has_room.wait(lock, [&]()
+                                  { return error || is_exhausted || next_index - delivered_count < options.max_pending_count; });
+                    if (error || is_exhausted)
+                    {
+                        return;
+                    }
+                    // the source is only called under the lock, it needs no synchronization of its own
+                    auto query = queries();
+                    if (!query)
+                    {
+                        is_exhausted = true;
+                        has_room.notify_all();
+                        return;
+                    }
+                    const std::size_t index = next_index++;
+                    lock.unlock();
+                    auto documents = search_server.FindTopDocuments(*query);
+                    lock.lock();
+                    completed.emplace(index, std::move(documents));
+
+                    // one worker at a time hands results over; the others only leave theirs
+                    // in completed, the delivering worker checks again before it stops
+                    if (is_delivering)
+                    {
+                        continue;
+                    }
+                    is_delivering = true;
+                    while (!error && !completed.empty() && (!options.is_ordered || completed.begin()->first == delivered_count))
+                    {
+                        auto result = completed.extract(completed.begin());
+                        lock.unlock();
+                        sink(result.key(), std::move(result.mapped()));
+                        lock.lock();
+                        ++delivered_count;
+                        has_room.notify_all();
+                    }
+                    is_delivering = false;
+                }
+            }
+            catch (...)
+            {
+                if (!lock.owns_lock())
+                {
+                    lock.lock();
+                }
+                if (!error)
+                {
+                    error = std::current_exception();
+                }
+                has_room.notify_all();
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (std::size_t i = 1; i < options.worker_count; ++i)
+        {
+            workers.emplace_back(work);
+        }
+        work();
+        for (std::thread &worker : workers)
+        {
+            worker.join();
+        }
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+}
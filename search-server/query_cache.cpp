@@ -0,0 +1,90 @@
+#include "query_cache.h"
+
+#include <algorithm>
+#include <functional>
+
+using namespace std;
+
+QueryResultCache::QueryResultCache(size_t capacity)
+    : capacity_(capacity), shard_count_(max<size_t>(1, min(capacity, MAX_SHARD_COUNT))),
+      shards_(make_unique<Shard[]>(shard_count_))
+{
+    // the capacity is split exactly, so the cache never holds more than it was given
+    for (size_t shard = 0; shard < shard_count_; ++shard)
+    {
+        shards_[shard].capacity = capacity / shard_count_ + (shard < capacity % shard_count_ ? 1 : 0);
+    }
+}
+
+optional<vector<Document>> QueryResultCache::Find(const string &key, uint64_t generation)
+{
+    Shard &shard = GetShard(key);
+    lock_guard guard(shard.mutex);
+    const auto it = shard.index.find(key);
+    if (it == shard.index.end())
+    {
+        ++misses_;
+        return nullopt;
+    }
+    const auto entry = it->second;
+    if (entry->generation != generation)
+    {
+        shard.index.erase(it);
+        shard.entries.erase(entry);
+        ++invalidations_;
+        ++misses_;
+        return nullopt;
+    }
+    shard.entries.splice(shard.entries.begin(), shard.entries, entry);
+    ++hits_;
+    return entry->documents;
+}
+
+void QueryResultCache::Insert(const string &key, uint64_t generation, const vector<Document> &documents)
+{
+    Shard &shard = GetShard(key);
+    if (shard.capacity == 0)
+    {
+        return;
+    }
+    lock_guard guard(shard.mutex);
+    // another thread may have computed the same query meanwhile
+    const auto it = shard.index.find(key);
+    if (it != shard.index.end())
+    {
+        const auto entry = it->second;
+        entry->generation = generation;
+        entry->documents = documents;
+        shard.entries.splice(shard.entries.begin(), shard.entries, entry);
+        return;
+    }
+    if (shard.entries.size() >= shard.capacity)
+    {
+        shard.index.erase(shard.entries.back().key);
+        shard.entries.pop_back();
+        ++evictions_;
+    }
+    shard.entries.push_front({key, generation, documents});
+    shard.index.emplace(shard.entries.front().key, shard.entries.begin());
+}
+
+QueryCacheStats QueryResultCache::GetStats() const
+{
+    QueryCacheStats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.evictions = evictions_;
+    stats.invalidations = invalidations_;
+    stats.capacity = capacity_;
+    for (size_t shard = 0; shard < shard_count_; ++shard)
+    {
+        lock_guard guard(shards_[shard].mutex);
+        stats.size += shards_[shard].entries.size();
+    }
+    return stats;
+}
+
+QueryResultCache::Shard &QueryResultCache::GetShard(const string &key)
+{
+    return shards_[hash<string>{}(key) % shard_count_];
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "document.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct QueryCacheStats
+{
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    // entries pushed out by newer ones because the cache was full
+    std::uint64_t evictions = 0;
+    // entries dropped because the index changed after they were computed
+    std::uint64_t invalidations = 0;
+    std::size_t size = 0;
+    std::size_t capacity = 0;
+};
+
+// size-bounded LRU of search results, split into shards with a lock each so parallel
+// queries rarely wait for one another; an entry remembers the index generation it was
+// computed at and counts as a miss once the index has moved on
+class QueryResultCache
+{
+public:
+    explicit QueryResultCache(std::size_t capacity);
+
+    std::optional<std::vector<Document>> Find(const std::string &key, std::uint64_t generation);
+
+    void Insert(const std::string &key, std::uint64_t generation, const std::vector<Document> &documents);
+
+    QueryCacheStats GetStats() const;
+
+private:
+    static constexpr std::size_t MAX_SHARD_COUNT = 16;
+
+    struct Entry
+    {
+        std::string key;
+        std::uint64_t generation;
+        std::vector<Document> documents;
+    };
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::size_t capacity = 0;
+        // most recently used first
+        std::list<Entry> entries;
+        // keys are views of the keys stored in entries
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+    };
+
+    std::size_t capacity_;
+    std::size_t shard_count_;
+    std::unique_ptr<Shard[]> shards_;
+
+    std::atomic<std::uint64_t> hits_ = 0;
+    std::atomic<std::uint64_t> misses_ = 0;
+    std::atomic<std::uint64_t> evictions_ = 0;
+    std::atomic<std::uint64_t> invalidations_ = 0;
+
+    Shard &GetShard(const std::string &key);
+};
@@ -1,37 +1,252 @@
-#include "remove_duplicates.h"
-
-#include <string_view>
-#include <map>
-#include <algorithm>
-
-using namespace std;
-
-void RemoveDuplicates(SearchServer &search_server)
-{
-    map<set<string_view>, int> words_to_id;
-    set<int> duplicate_ids;
-    set<int> ids;
-    for (const int id : search_server)
-    {
-        map<string_view, double> word_freqs = search_server.GetWordFrequencies(id);
-        set<string_view> words_to_compare;
-        for (auto word : word_freqs)
-        {
-            words_to_compare.insert(word.first);
-        }
-        if (words_to_id.count(words_to_compare))
-        {
-            duplicate_ids.insert(max(words_to_id.at(words_to_compare), id));
-            words_to_id[words_to_compare] = *(ids.begin());
-        }
-        else
-        {
-            words_to_id.insert(pair{words_to_compare, id});
-        }
-    }
-    for (const int id : duplicate_ids)
-    {
-        cout << "Found duplicate document id " << id << endl;
-        search_server.RemoveDocument(id);
-    }
-}
\ No newline at end of file
+#include "remove_duplicates.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <execution>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    using TermId = TermDictionary::TermId;
+
+    // 128 bits, so different word sets practically never share one; equal ones are still checked
+    using Signature = pair<uint64_t, uint64_t>;
+
+    const size_t MINHASH_HASH_COUNT = MINHASH_BAND_COUNT * MINHASH_BAND_ROWS;
+
+    // splitmix64 finalizer
+    uint64_t Mix(uint64_t value)
+    {
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+        return value ^ (value >> 31);
+    }
+
+    const auto MINHASH_SEEDS = []()
+    {
+        array<uint64_t, MINHASH_HASH_COUNT> seeds;
+        for (size_t i = 0; i < seeds.size(); ++i)
+        {
+            seeds[i] = Mix(i + 1);
+        }
+        return seeds;
+    }();
+
+    Signature ComputeSignature(const vector<TermId> &terms)
+    {
+        // two independent chains over the sorted terms
+        uint64_t high = terms.size();
+        uint64_t low = 0x9e3779b97f4a7c15ULL;
+        for (const TermId term : terms)
+        {
+            high = Mix(high ^ term);
+            low = Mix(low + term * 0xc2b2ae3d27d4eb4fULL);
+        }
+        return {high, low};
+    }
+
+    vector<int> GetDocumentIds(const SearchServer &search_server)
+    {
+        return {search_server.begin(), search_server.end()};
+    }
+
+    double ComputeSimilarity(const vector<TermId> &lhs, const vector<TermId> &rhs)
+    {
+        size_t common_count = 0;
+        for (auto lhs_it = lhs.begin(), rhs_it = rhs.begin(); lhs_it != lhs.end() && rhs_it != rhs.end();)
+        {
+            if (*lhs_it < *rhs_it)
+            {
+                ++lhs_it;
+            }
+            else if (*rhs_it < *lhs_it)
+            {
+                ++rhs_it;
+            }
+            else
+            {
+                ++common_count;
+                ++lhs_it;
+                ++rhs_it;
+            }
+        }
+        const size_t union_count = lhs.size() + rhs.size() - common_count;
+        // documents of stop words only have equal, empty sets
+        return union_count == 0 ? 1.0 : static_cast<double>(common_count) / union_count;
+    }
+
+    void RemoveFound(SearchServer &search_server, vector<int> &duplicate_ids)
+    {
+        sort(duplicate_ids.begin(), duplicate_ids.end());
+        for (const int id : duplicate_ids)
+        {
+            cout << "Found duplicate document id " << id << endl;
+        }
+        search_server.RemoveDocuments(duplicate_ids);
+    }
+}
+
+void RemoveDuplicates(SearchServer &search_server)
+{
+    const vector<int> ids = GetDocumentIds(search_server);
+    vector<Signature> signatures(ids.size());
+    vector<size_t> positions(ids.size());
+    iota(positions.begin(), positions.end(), 0);
+    for_each(execution::par, positions.begin(), positions.end(), [&](size_t position)
+             {
+                 thread_local vector<TermId> terms;
+                 search_server.GetDocumentTerms(ids[position], terms);
+                 signatures[position] = ComputeSignature(terms); });
+    // ids ascend with positions, so each group starts with the document to keep
+    sort(execution::par, positions.begin(), positions.end(), [&signatures](size_t lhs, size_t rhs)
+         { return tie(signatures[lhs], lhs) < tie(signatures[rhs], rhs); });
+
+    vector<int> duplicate_ids;
+    for (auto group_begin = positions.begin(); group_begin != positions.end();)
+    {
+        const auto group_end = find_if(group_begin + 1, positions.end(), [&](size_t position)
+                                       { return signatures[position] != signatures[*group_begin]; });
+        if (group_end - group_begin > 1)
+        {
+            // only here the terms are compared; a group may mix sets that collided
+            vector<vector<TermId>> kept_terms;
+            vector<TermId> terms;
+            for (auto it = group_begin; it != group_end; ++it)
+            {
+                search_server.GetDocumentTerms(ids[*it], terms);
+                if (find(kept_terms.begin(), kept_terms.end(), terms) != kept_terms.end())
+                {
+                    duplicate_ids.push_back(ids[*it]);
+                }
+                else
+                {
+                    kept_terms.push_back(terms);
+                }
+            }
+        }
+        group_begin = group_end;
+    }
+    RemoveFound(search_server, duplicate_ids);
+}
+
+void RemoveNearDuplicates(SearchServer &search_server, double similarity_threshold)
+{
+    if (!(similarity_threshold > 0.0 && similarity_threshold <= 1.0))
+    {
+        throw invalid_argument("Similarity threshold must be in (0, 1]");
+    }
+    const vector<int> ids = GetDocumentIds(search_server);
+    vector<vector<TermId>> document_terms(ids.size());
+    // band keys of every document, MINHASH_BAND_COUNT per document
+    vector<uint64_t> band_keys(ids.size() * MINHASH_BAND_COUNT);
+    vector<size_t> positions(ids.size());
+    iota(positions.begin(), positions.end(), 0);
+    for_each(execution::par, positions.begin(), positions.end(), [&](size_t position)
+             {
+                 vector<TermId> &terms = document_terms[position];
+                 search_server.GetDocumentTerms(ids[position], terms);
+                 uint64_t min_hashes[MINHASH_HASH_COUNT];
+                 fill(begin(min_hashes), end(min_hashes), numeric_limits<uint64_t>::max());
+                 for (const TermId term : terms)
+                 {
+                     // one full hash per term, then a multiply per hash function
+                     const uint64_t term_hash = Mix(term);
+                     for (size_t i = 0; i < MINHASH_HASH_COUNT; ++i)
+                     {
+                         min_hashes[i] = min<uint64_t>(min_hashes[i], (term_hash ^ MINHASH_SEEDS[i]) * 0x9e3779b97f4a7c15ULL);
+                     }
+                 }
+                 for (size_t band = 0; band < MINHASH_BAND_COUNT; ++band)
+                 {
+                     uint64_t key = Mix(band + 1);
+                     for (size_t row = 0; row < MINHASH_BAND_ROWS; ++row)
+                     {
+                         key = Mix(key ^ min_hashes[band * MINHASH_BAND_ROWS + row]);
+                     }
+                     band_keys[position * MINHASH_BAND_COUNT + band] = key;
+                 }
+             });
+
+    // buckets of documents sharing a band, sorted by key band by band; a document alone in its
+    // bucket cannot be a candidate, so only shared buckets are kept, members in id order
+    const uint32_t NO_BUCKET = numeric_limits<uint32_t>::max();
+    vector<uint32_t> document_buckets(band_keys.size(), NO_BUCKET);
+    vector<vector<uint32_t>> bucket_begins(MINHASH_BAND_COUNT);
+    vector<vector<uint32_t>> bucket_members(MINHASH_BAND_COUNT);
+    vector<size_t> bands(MINHASH_BAND_COUNT);
+    iota(bands.begin(), bands.end(), 0);
+    for_each(execution::par, bands.begin(), bands.end(), [&](size_t band)
+             {
+                 vector<pair<uint64_t, uint32_t>> keys;
+                 keys.reserve(ids.size());
+                 for (size_t position = 0; position < ids.size(); ++position)
+                 {
+                     keys.push_back({band_keys[position * MINHASH_BAND_COUNT + band], static_cast<uint32_t>(position)});
+                 }
+                 sort(keys.begin(), keys.end());
+                 vector<uint32_t> &begins = bucket_begins[band];
+                 vector<uint32_t> &members = bucket_members[band];
+                 for (auto it = keys.begin(); it != keys.end();)
+                 {
+                     const auto bucket_end = find_if(it + 1, keys.end(), [key = it->first](const auto &entry)
+                                                     { return entry.first != key; });
+                     if (bucket_end - it > 1)
+                     {
+                         for (; it != bucket_end; ++it)
+                         {
+                             document_buckets[it->second * MINHASH_BAND_COUNT + band] = static_cast<uint32_t>(begins.size());
+                             members.push_back(it->second);
+                         }
+                         begins.push_back(static_cast<uint32_t>(members.size()));
+                     }
+                     it = bucket_end;
+                 }
+             });
+    band_keys.clear();
+    band_keys.shrink_to_fit();
+
+    // in id order, a document is compared with the kept ones before it sharing a band with it
+    vector<bool> is_kept(ids.size(), true);
+    // the document a candidate was last compared with, so each pair is compared once
+    vector<size_t> compared_with(ids.size(), numeric_limits<size_t>::max());
+    vector<int> duplicate_ids;
+    for (size_t position = 0; position < ids.size(); ++position)
+    {
+        for (size_t band = 0; band < MINHASH_BAND_COUNT && is_kept[position]; ++band)
+        {
+            const uint32_t bucket = document_buckets[position * MINHASH_BAND_COUNT + band];
+            if (bucket == NO_BUCKET)
+            {
+                continue;
+            }
+            const vector<uint32_t> &members = bucket_members[band];
+            const size_t begin = bucket > 0 ? bucket_begins[band][bucket - 1] : 0;
+            for (size_t i = begin; members[i] < position; ++i)
+            {
+                const size_t candidate = members[i];
+                if (!is_kept[candidate] || compared_with[candidate] == position)
+                {
+                    continue;
+                }
+                compared_with[candidate] = position;
+                if (ComputeSimilarity(document_terms[candidate], document_terms[position]) >= similarity_threshold)
+                {
+                    is_kept[position] = false;
+                    duplicate_ids.push_back(ids[position]);
+                    break;
+                }
+            }
+        }
+    }
+    RemoveFound(search_server, duplicate_ids);
+}
@@ -1,5 +1,16 @@
-#pragma once
-
-#include "search_server.h"
-
-void RemoveDuplicates(SearchServer &search_server);
+#pragma once
+
+#include "search_server.h"
+
+// MinHash signature of a document is MINHASH_BAND_COUNT bands of MINHASH_BAND_ROWS hashes;
+// two documents become candidates when any band matches whole
+const std::size_t MINHASH_BAND_COUNT = 32;
+const std::size_t MINHASH_BAND_ROWS = 4;
+
+// removes documents with the same set of words as a document with a smaller id
+void RemoveDuplicates(SearchServer &search_server);
+
+// removes documents whose set of words is at least similarity_threshold alike (Jaccard) to a
+// remaining document with a smaller id. Candidates come from MinHash bands, so a pair just
+// above a low threshold (below about 0.5) may be missed; similarity itself is exact.
+void RemoveNearDuplicates(SearchServer &search_server, double similarity_threshold);
@@ -2,46 +2,118 @@
 
 #include "document.h"
 
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
 using namespace std;
 
-RequestQueue::RequestQueue(const SearchServer &search_server)
-    : search_server_(search_server), no_results_requests_(0), current_time_(0)
+RequestQueue::RequestQueue(const SearchServer &search_server, Clock::duration window, size_t capacity)
+    : search_server_(search_server), window_(chrono::duration_cast<chrono::nanoseconds>(window).count()), slots_(capacity)
 {
+    if (capacity == 0 || window <= Clock::duration::zero())
+    {
+        throw invalid_argument("Request queue needs a window and slots");
+    }
 }
 
 vector<Document> RequestQueue::AddFindRequest(string_view raw_query, DocumentStatus status)
 {
+    const auto start_time = Clock::now();
     const auto result = search_server_.FindTopDocuments(raw_query, status);
-    AddRequest(result.size());
+    AddRequest(start_time, result.size());
     return result;
 }
 
 vector<Document> RequestQueue::AddFindRequest(string_view raw_query)
 {
+    const auto start_time = Clock::now();
     const auto result = search_server_.FindTopDocuments(raw_query);
-    AddRequest(result.size());
+    AddRequest(start_time, result.size());
     return result;
 }
 
 int RequestQueue::GetNoResultRequests() const
 {
-    return no_results_requests_;
+    int count = 0;
+    ForEachWindowRequest(GetTimestamp(Clock::now()), [&count](const Request &request)
+                         { count += request.result_count == 0; });
+    return count;
 }
 
-void RequestQueue::AddRequest(int results_num)
+RequestQueueStats RequestQueue::GetStats() const
 {
-    ++current_time_;
-    while (!requests_.empty() && min_in_day_ <= current_time_ - requests_.front().timestamp)
+    const uint64_t now = GetTimestamp(Clock::now());
+    vector<Request> requests;
+    ForEachWindowRequest(now, [&requests](const Request &request)
+                         { requests.push_back(request); });
+    RequestQueueStats stats;
+    stats.request_count = requests.size();
+    if (requests.empty())
     {
-        if (0 == requests_.front().results)
-        {
-            --no_results_requests_;
-        }
-        requests_.pop_front();
+        return stats;
     }
-    requests_.push_back({current_time_, results_num});
-    if (0 == results_num)
+    stats.no_result_count = count_if(requests.begin(), requests.end(), [](const Request &request)
+                                     { return request.result_count == 0; });
+    stats.no_result_rate = static_cast<double>(stats.no_result_count) / requests.size();
+
+    // a full ring may have dropped older requests of the window, then the rate is taken over the
+    // time the ring covers; a queue younger than the window is judged by its age
+    uint64_t span = min(window_, now);
+    if (requests.size() == slots_.size())
     {
-        ++no_results_requests_;
+        span = now - min_element(requests.begin(), requests.end(), [](const Request &lhs, const Request &rhs)
+                                 { return lhs.timestamp < rhs.timestamp; })
+                         ->timestamp;
     }
-}
\ No newline at end of file
+    stats.queries_per_second = span > 0 ? requests.size() / (span / 1e9) : 0.0;
+
+    const auto get_latency = [&requests](double quantile)
+    {
+        const size_t rank = min(requests.size() - 1, static_cast<size_t>(quantile * requests.size()));
+        nth_element(requests.begin(), requests.begin() + rank, requests.end(), [](const Request &lhs, const Request &rhs)
+                    { return lhs.latency < rhs.latency; });
+        return chrono::nanoseconds(requests[rank].latency);
+    };
+    stats.latency_p50 = get_latency(0.5);
+    stats.latency_p95 = get_latency(0.95);
+    stats.latency_p99 = get_latency(0.99);
+    return stats;
+}
+
+uint64_t RequestQueue::GetTimestamp(Clock::time_point time) const
+{
+    return chrono::duration_cast<chrono::nanoseconds>(time - start_time_).count();
+}
+
+void RequestQueue::AddRequest(Clock::time_point start_time, size_t result_count)
+{
+    const auto end_time = Clock::now();
+    const uint64_t ticket = next_ticket_.fetch_add(1, memory_order_relaxed);
+    Slot &slot = slots_[ticket % slots_.size()];
+    // only a writer a whole ring ahead or behind can meet this one at the slot. The older request
+    // of the two would be overwritten anyway, so it is the one dropped: a newer writer keeps the
+    // slot, an older one still writing is waited for, it is a few stores away from done
+    uint64_t sequence = slot.sequence.load(memory_order_relaxed);
+    while (true)
+    {
+        if (sequence > 2 * ticket)
+        {
+            return;
+        }
+        if (sequence % 2 == 1)
+        {
+            this_thread::yield();
+            sequence = slot.sequence.load(memory_order_relaxed);
+        }
+        else if (slot.sequence.compare_exchange_weak(sequence, 2 * ticket + 1, memory_order_acquire, memory_order_relaxed))
+        {
+            break;
+        }
+    }
+    atomic_thread_fence(memory_order_release);
+    slot.timestamp.store(GetTimestamp(end_time), memory_order_relaxed);
+    slot.latency.store(chrono::duration_cast<chrono::nanoseconds>(end_time - start_time).count(), memory_order_relaxed);
+    slot.result_count.store(result_count, memory_order_relaxed);
+    slot.sequence.store(2 * ticket + 2, memory_order_release);
+}
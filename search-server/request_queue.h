@@ -2,15 +2,39 @@
 
 #include "search_server.h"
 
+#include <atomic>
+#include <chrono>
+#include <cstddef>
 #include <string_view>
 #include <vector>
-#include <deque>
 #include <cstdint>
 
+// slots of the request ring; a window with more requests than this is judged by the latest ones
+const std::size_t REQUEST_QUEUE_CAPACITY = 1 << 14;
+
+struct RequestQueueStats
+{
+    // requests the statistics are taken over, the whole window unless the ring is shorter
+    std::size_t request_count = 0;
+    std::size_t no_result_count = 0;
+    double queries_per_second = 0.0;
+    double no_result_rate = 0.0;
+    // of FindTopDocuments calls
+    std::chrono::nanoseconds latency_p50{};
+    std::chrono::nanoseconds latency_p95{};
+    std::chrono::nanoseconds latency_p99{};
+};
+
+// Runs queries and keeps the requests of the last window of real time. Any number of threads may
+// add requests and read statistics at once: a request takes a slot of a ring with one atomic
+// increment and publishes it under the slot's sequence number, readers skip slots being written.
 class RequestQueue
 {
 public:
-    explicit RequestQueue(const SearchServer &search_server);
+    using Clock = std::chrono::steady_clock;
+
+    explicit RequestQueue(const SearchServer &search_server, Clock::duration window = std::chrono::minutes(1),
+                          std::size_t capacity = REQUEST_QUEUE_CAPACITY);
 
     template <typename DocumentPredicate>
     std::vector<Document> AddFindRequest(std::string_view raw_query, DocumentPredicate document_predicate);
@@ -19,27 +43,77 @@ public:
 
     std::vector<Document> AddFindRequest(std::string_view raw_query);
 
+    // in the window; counts over the whole ring without allocating, like GetStats it is
+    // cheap enough for a monitoring thread but not meant for every request
     int GetNoResultRequests() const;
 
+    // scans the whole ring, meant for a monitoring thread rather than every request
+    RequestQueueStats GetStats() const;
+
 private:
-    struct QueryResult
+    // sequence is 0 while empty, odd while its request is written and even once it is published
+    struct alignas(64) Slot
+    {
+        std::atomic<std::uint64_t> sequence = 0;
+        std::atomic<std::uint64_t> timestamp = 0;
+        std::atomic<std::uint64_t> latency = 0;
+        std::atomic<std::uint64_t> result_count = 0;
+    };
+
+    struct Request
     {
         std::uint64_t timestamp;
-        int results;
+        std::uint64_t latency;
+        std::uint64_t result_count;
     };
-    std::deque<QueryResult> requests_;
+
     const SearchServer &search_server_;
-    int no_results_requests_;
-    std::uint64_t current_time_;
-    const static int min_in_day_ = 1440;
+    const Clock::time_point start_time_ = Clock::now();
+    const std::uint64_t window_;
+    std::vector<Slot> slots_;
+    std::atomic<std::uint64_t> next_ticket_ = 0;
+
+    // nanoseconds since the queue was created
+    std::uint64_t GetTimestamp(Clock::time_point time) const;
+
+    void AddRequest(Clock::time_point start_time, std::size_t result_count);
 
-    void AddRequest(int results_num);
+    // calls visitor(request) for published requests of the window, in no particular order
+    template <typename RequestVisitor>
+    void ForEachWindowRequest(std::uint64_t now, RequestVisitor visitor) const;
 };
 
 template <typename DocumentPredicate>
 std::vector<Document> RequestQueue::AddFindRequest(std::string_view raw_query, DocumentPredicate document_predicate)
 {
+    const auto start_time = Clock::now();
     const auto result = search_server_.FindTopDocuments(raw_query, document_predicate);
-    AddRequest(result.size());
+    AddRequest(start_time, result.size());
     return result;
-}
\ No newline at end of file
+}
+
+template <typename RequestVisitor>
+void RequestQueue::ForEachWindowRequest(std::uint64_t now, RequestVisitor visitor) const
+{
+    for (const Slot &slot : slots_)
+    {
+        const std::uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence == 0 || sequence % 2 == 1)
+        {
+            continue;
+        }
+        const Request request{slot.timestamp.load(std::memory_order_relaxed), slot.latency.load(std::memory_order_relaxed),
+                              slot.result_count.load(std::memory_order_relaxed)};
+        // a writer took the slot meanwhile, the values may be torn
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence)
+        {
+            continue;
+        }
+        // requests finished after now are left for the next call
+        if (request.timestamp <= now && now - request.timestamp < window_)
+        {
+            visitor(request);
+        }
+    }
+}
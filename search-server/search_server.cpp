@@ -1,5 +1,8 @@
 #include "search_server.h"
 
+#include <numeric>
+#include <optional>
+
 using namespace std;
 
 SearchServer::SearchServer(string_view stop_words_text)
@@ -17,24 +20,44 @@ SearchServer::SearchServer(const string &stop_words_text)
 void SearchServer::AddDocument(int document_id, string_view document, DocumentStatus status,
                                const vector<int> &ratings)
 {
-    if ((document_id < 0) || (documents_.count(document_id) > 0))
+    if ((document_id < 0) || (id_to_document_index_.count(document_id) > 0))
     {
         throw invalid_argument("Invalid document_id"s);
     }
-    auto words = SplitIntoWordsViewNoStop(document);
-    const double inv_word_count = 1.0 / words.size();
-    string word_original;
-    string_view word_view;
-    for (auto word : words)
+    const auto terms = InternWordsNoStop(document);
+    const double inv_word_count = 1.0 / terms.size();
+    const auto document_index = static_cast<DocumentIndex>(documents_.size());
+    map<TermId, uint32_t> term_counts;
+    for (const TermId term : terms)
+    {
+        ++term_counts[term];
+    }
+    auto &document_terms = document_terms_.Mutable();
+    documents_.Mutable().push_back({document_id, ComputeAverageRating(ratings), status, static_cast<uint32_t>(term_counts.size()),
+                                    document_terms.size(), inv_word_count});
+    // document indexes only grow, so appending keeps every posting list sorted
+    term_document_freqs_.resize(dictionary_.GetSize());
+    term_log_document_freqs_.resize(dictionary_.GetSize());
+    auto &term_max_freqs = term_max_freqs_.Mutable();
+    term_max_freqs.resize(dictionary_.GetSize());
+    for (const auto [term, term_count] : term_counts)
     {
-        word_original = word;
-        words_.insert(word_original);
-        word_view = *words_.find(word_original);
-        word_to_document_freqs_[word_view][document_id] += inv_word_count;
-        id_to_word_freqs_[document_id][word_view] += inv_word_count;
+        document_terms.push_back({term, term_count});
+        active_segment_.Append(term, document_index, term_count);
+        ++term_document_freqs_[term];
+        term_max_freqs[term] = max(term_max_freqs[term], term_count * inv_word_count);
+        UpdateTermLogDocumentFreq(term);
     }
-    documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status});
+    active_segment_.ExtendTo(document_index + 1);
+    id_to_document_index_.emplace(document_id, document_index);
     document_ids_.insert(document_id);
+    UpdateLogDocumentCount();
+    ++index_generation_;
+    if (active_segment_.GetDocumentCount() >= SEGMENT_DOCUMENT_COUNT)
+    {
+        SealActiveSegment();
+        ScheduleMerge();
+    }
 }
 
 void SearchServer::RemoveDocument(int document_id)
@@ -44,44 +67,284 @@ void SearchServer::RemoveDocument(int document_id)
 
 void SearchServer::RemoveDocument(const execution::sequenced_policy &, int document_id)
 {
-    if (!document_ids_.count(document_id))
+    const auto it = id_to_document_index_.find(document_id);
+    if (it == id_to_document_index_.end())
     {
         return;
     }
+    const DocumentIndex document_index = it->second;
+    id_to_document_index_.erase(it);
     document_ids_.erase(document_id);
-    documents_.erase(document_id);
-    for (auto [word, freq] : GetWordFrequencies(document_id))
+    const DocumentData &document = documents_[document_index];
+    // postings are left to the tombstone, only the frequencies IDF depends on change
+    for (size_t i = 0; i < document.term_count; ++i)
     {
-        word_to_document_freqs_.at(word).erase(document_id);
+        const TermId term = document_terms_[document.terms_begin + i].term;
+        --term_document_freqs_[term];
+        UpdateTermLogDocumentFreq(term);
     }
-    id_to_word_freqs_.erase(document_id);
+    MarkRemoved(document_index);
+    FinishRemoval();
 }
 
 void SearchServer::RemoveDocument(const execution::parallel_policy &, int document_id)
 {
-    if (!document_ids_.count(document_id))
+    const auto it = id_to_document_index_.find(document_id);
+    if (it == id_to_document_index_.end())
     {
         return;
     }
+    const DocumentIndex document_index = it->second;
+    id_to_document_index_.erase(it);
     document_ids_.erase(document_id);
-    documents_.erase(document_id);
-    auto word_freq = id_to_word_freqs_.at(document_id);
-    vector<string_view> ptrs_to_words(word_freq.size());
-    transform(execution::par, word_freq.begin(), word_freq.end(), ptrs_to_words.begin(), [](auto word)
-              { return word.first; });
-    for_each(execution::par, ptrs_to_words.begin(), ptrs_to_words.end(),
-             [this, document_id](auto word)
+    const DocumentData &document = documents_[document_index];
+    const DocumentTerm *terms_begin = document_terms_.data() + document.terms_begin;
+    for_each(execution::par, terms_begin, terms_begin + document.term_count,
+             [this](const DocumentTerm &document_term)
              {
-                 word_to_document_freqs_.at(word).erase(document_id);
+                 --term_document_freqs_[document_term.term];
+                 UpdateTermLogDocumentFreq(document_term.term);
              });
-    id_to_word_freqs_.erase(document_id);
+    MarkRemoved(document_index);
+    FinishRemoval();
+}
+
+void SearchServer::RemoveDocuments(const vector<int> &document_ids)
+{
+    vector<TermId> changed_terms;
+    bool is_any_removed = false;
+    for (const int document_id : document_ids)
+    {
+        const auto it = id_to_document_index_.find(document_id);
+        if (it == id_to_document_index_.end())
+        {
+            continue;
+        }
+        const DocumentIndex document_index = it->second;
+        id_to_document_index_.erase(it);
+        document_ids_.erase(document_id);
+        const DocumentData &document = documents_[document_index];
+        for (size_t i = 0; i < document.term_count; ++i)
+        {
+            const TermId term = document_terms_[document.terms_begin + i].term;
+            --term_document_freqs_[term];
+            changed_terms.push_back(term);
+        }
+        MarkRemoved(document_index);
+        is_any_removed = true;
+    }
+    if (!is_any_removed)
+    {
+        return;
+    }
+    SortUnique(changed_terms);
+    for (const TermId term : changed_terms)
+    {
+        UpdateTermLogDocumentFreq(term);
+    }
+    FinishRemoval();
+}
+
+void SearchServer::MarkRemoved(DocumentIndex document_index)
+{
+    if (removed_documents_.size() < documents_.size())
+    {
+        removed_documents_.resize(documents_.size());
+    }
+    removed_documents_[document_index] = true;
+    documents_.Mutable()[document_index].term_count = 0;
+}
+
+void SearchServer::FinishRemoval()
+{
+    UpdateLogDocumentCount();
+    ++index_generation_;
+
+    const size_t removed_count = documents_.size() - id_to_document_index_.size();
+    if (is_auto_compaction_enabled_ && removed_count >= COMPACTION_MIN_REMOVED_DOCUMENT_COUNT &&
+        removed_count > id_to_document_index_.size())
+    {
+        Compact();
+    }
+}
+
+void SearchServer::AddDocumentBatch(const vector<const NewDocument *> &batch, bool is_parallel)
+{
+    if (batch.empty())
+    {
+        return;
+    }
+    struct TokenizedDocument
+    {
+        // non-stop words in text order, TermDictionary::NO_TERM until a new word is interned
+        vector<TermId> terms;
+        vector<pair<size_t, string_view>> new_words;
+        optional<string_view> invalid_word;
+        vector<DocumentTerm> document_terms;
+    };
+    struct TermPosting
+    {
+        TermId term;
+        Posting posting;
+    };
+
+    // documents are split into contiguous chunks, so every chunk sees increasing document indexes;
+    // a few chunks per thread even out documents of different length
+    const size_t chunk_count = is_parallel ? min<size_t>(batch.size(), max(1u, thread::hardware_concurrency()) * 4) : 1;
+    vector<size_t> chunk_begins(chunk_count + 1);
+    for (size_t chunk = 0; chunk <= chunk_count; ++chunk)
+    {
+        chunk_begins[chunk] = batch.size() * chunk / chunk_count;
+    }
+    vector<size_t> chunks(chunk_count);
+    iota(chunks.begin(), chunks.end(), 0);
+    const auto for_each_chunk = [&chunks](const auto &function)
+    {
+        for_each(execution::par, chunks.begin(), chunks.end(), function);
+    };
+
+    // splitting, validation and lookups of known words only read the dictionary
+    vector<TokenizedDocument> tokenized(batch.size());
+    for_each_chunk([&](size_t chunk)
+                   {
+                       vector<string_view> words;
+                       for (size_t i = chunk_begins[chunk]; i < chunk_begins[chunk + 1]; ++i)
+                       {
+                           TokenizedDocument &document = tokenized[i];
+                           const size_t first_invalid_word = SplitIntoWordsView(batch[i]->text, words);
+                           if (first_invalid_word != words.size())
+                           {
+                               document.invalid_word = words[first_invalid_word];
+                               continue;
+                           }
+                           for (const string_view word : words)
+                           {
+                               const TermId term = dictionary_.Find(word);
+                               if (term == TermDictionary::NO_TERM)
+                               {
+                                   document.new_words.push_back({document.terms.size(), word});
+                                   document.terms.push_back(term);
+                               }
+                               else if (!IsStopTerm(term))
+                               {
+                                   document.terms.push_back(term);
+                               }
+                           }
+                       } });
+
+    // new words are interned in document order, so term ids match adding the documents one by one
+    const auto first_document_index = static_cast<DocumentIndex>(documents_.size());
+    size_t accepted_count = 0;
+    string error;
+    for (; accepted_count < batch.size(); ++accepted_count)
+    {
+        const int document_id = batch[accepted_count]->id;
+        TokenizedDocument &document = tokenized[accepted_count];
+        if (document_id < 0 || id_to_document_index_.count(document_id) > 0)
+        {
+            error = "Invalid document_id"s;
+            break;
+        }
+        if (document.invalid_word)
+        {
+            error = "Word "s + string(*document.invalid_word) + " is invalid"s;
+            break;
+        }
+        for (const auto &[position, word] : document.new_words)
+        {
+            document.terms[position] = dictionary_.Intern(word);
+        }
+        id_to_document_index_.emplace(document_id, first_document_index + accepted_count);
+        document_ids_.insert(document_id);
+    }
+    for (size_t chunk = 0; chunk <= chunk_count; ++chunk)
+    {
+        chunk_begins[chunk] = min(chunk_begins[chunk], accepted_count);
+    }
+
+    // per-thread partial inverted indexes, split into shards by term; a shard keeps document order
+    const size_t shard_count = chunk_count;
+    vector<vector<vector<TermPosting>>> partial_indexes(chunk_count, vector<vector<TermPosting>>(shard_count));
+    for_each_chunk([&](size_t chunk)
+                   {
+                       vector<vector<TermPosting>> &partial_index = partial_indexes[chunk];
+                       for (size_t i = chunk_begins[chunk]; i < chunk_begins[chunk + 1]; ++i)
+                       {
+                           TokenizedDocument &document = tokenized[i];
+                           vector<TermId> &terms = document.terms;
+                           sort(terms.begin(), terms.end());
+                           for (auto it = terms.begin(); it != terms.end();)
+                           {
+                               const auto run_end = upper_bound(it, terms.end(), *it);
+                               const auto term_count = static_cast<uint32_t>(run_end - it);
+                               document.document_terms.push_back({*it, term_count});
+                               partial_index[*it % shard_count].push_back({*it, {static_cast<DocumentIndex>(first_document_index + i), term_count}});
+                               it = run_end;
+                           }
+                       } });
+
+    auto &documents = documents_.Mutable();
+    auto &document_terms = document_terms_.Mutable();
+    for (size_t i = 0; i < accepted_count; ++i)
+    {
+        const NewDocument &document = *batch[i];
+        const TokenizedDocument &tokenized_document = tokenized[i];
+        documents.push_back({document.id, ComputeAverageRating(document.ratings), document.status,
+                             static_cast<uint32_t>(tokenized_document.document_terms.size()), document_terms.size(),
+                             1.0 / tokenized_document.terms.size()});
+        document_terms.insert(document_terms.end(), tokenized_document.document_terms.begin(), tokenized_document.document_terms.end());
+    }
+
+    // the batch becomes a segment of its own; a shard is merged by one thread, chunk after chunk,
+    // so posting lists stay sorted without locks
+    vector<PostingList> batch_postings(dictionary_.GetSize());
+    term_document_freqs_.resize(dictionary_.GetSize());
+    auto &term_max_freqs = term_max_freqs_.Mutable();
+    term_max_freqs.resize(dictionary_.GetSize());
+    term_log_document_freqs_.resize(dictionary_.GetSize());
+    // a term belongs to a single shard, so the flags are never written concurrently
+    vector<char> is_term_changed(dictionary_.GetSize(), 0);
+    for_each_chunk([&](size_t shard)
+                   {
+                       vector<TermId> changed_terms;
+                       for (const vector<vector<TermPosting>> &partial_index : partial_indexes)
+                       {
+                           for (const auto &[term, posting] : partial_index[shard])
+                           {
+                               batch_postings[term].Append(posting.document_index, posting.term_count);
+                               ++term_document_freqs_[term];
+                               term_max_freqs[term] = max(term_max_freqs[term], posting.term_count * documents[posting.document_index].inv_word_count);
+                               if (!is_term_changed[term])
+                               {
+                                   is_term_changed[term] = 1;
+                                   changed_terms.push_back(term);
+                               }
+                           }
+                       }
+                       for (const TermId term : changed_terms)
+                       {
+                           UpdateTermLogDocumentFreq(term);
+                       } });
+    UpdateLogDocumentCount();
+    // documents accepted before an invalid one stay, so the index changed either way
+    ++index_generation_;
+    if (accepted_count > 0)
+    {
+        SealActiveSegment();
+        segments_.push_back(make_shared<IndexSegment>(first_document_index, static_cast<DocumentIndex>(first_document_index + accepted_count),
+                                                      move(batch_postings)));
+        ScheduleMerge();
+    }
+
+    if (!error.empty())
+    {
+        throw invalid_argument(error);
+    }
 }
 
-vector<Document> SearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status) const
+vector<Document> SearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status, size_t max_count) const
 {
-    return FindTopDocuments(
-        execution::seq, raw_query, [status](int document_id, DocumentStatus document_status, int rating)
-        { return document_status == status; });
+    return FindTopDocuments(execution::seq, raw_query, status, max_count);
 }
 
 vector<Document> SearchServer::FindTopDocuments(string_view raw_query) const
@@ -89,9 +352,22 @@ vector<Document> SearchServer::FindTopDocuments(string_view raw_query) const
     return FindTopDocuments(execution::seq, raw_query, DocumentStatus::ACTUAL);
 }
 
+ExplainedDocuments SearchServer::FindTopDocumentsExplained(string_view raw_query, DocumentStatus status, size_t max_count) const
+{
+    return FindTopDocumentsExplained(
+        raw_query, [status](int document_id, DocumentStatus document_status, int rating)
+        { return document_status == status; },
+        max_count);
+}
+
+ExplainedDocuments SearchServer::FindTopDocumentsExplained(string_view raw_query) const
+{
+    return FindTopDocumentsExplained(raw_query, DocumentStatus::ACTUAL);
+}
+
 int SearchServer::GetDocumentCount() const
 {
-    return documents_.size();
+    return id_to_document_index_.size();
 }
 
 typename set<int>::const_iterator SearchServer::begin() const
@@ -104,14 +380,24 @@ typename set<int>::const_iterator SearchServer::end() const
     return document_ids_.end();
 }
 
-map<string_view, double> SearchServer::GetWordFrequencies(int document_id) const
+SearchServer::WordFrequencies SearchServer::GetWordFrequencies(int document_id) const
+{
+    if (id_to_document_index_.empty())
+    {
+        return {};
+    }
+    const DocumentData &document = documents_[GetDocumentIndex(document_id)];
+    return {dictionary_, document_terms_.data() + document.terms_begin, document.term_count, document.inv_word_count};
+}
+
+void SearchServer::GetDocumentTerms(int document_id, vector<TermId> &terms) const
 {
-    if (id_to_word_freqs_.empty())
+    const DocumentData &document = documents_[GetDocumentIndex(document_id)];
+    terms.clear();
+    for (size_t i = 0; i < document.term_count; ++i)
     {
-        static map<string_view, double> empty_map;
-        return empty_map;
+        terms.push_back(document_terms_[document.terms_begin + i].term);
     }
-    return id_to_word_freqs_.at(document_id);
 }
 
 using MatchTuple = tuple<vector<string_view>, DocumentStatus>;
@@ -125,10 +411,7 @@ MatchTuple SearchServer::MatchDocument(string_view raw_query,
 MatchTuple SearchServer::MatchDocument(const execution::sequenced_policy &, string_view raw_query,
                                        int document_id) const
 {
-    if ((document_id < 0) || (documents_.count(document_id) <= 0))
-    {
-        throw out_of_range("Invalid document_id"s);
-    }
+    const DocumentIndex document_index = GetDocumentIndex(document_id);
     if (!IsValidWord(raw_query))
     {
         throw invalid_argument("Invalid query");
@@ -138,39 +421,29 @@ MatchTuple SearchServer::MatchDocument(const execution::sequenced_policy &, stri
 
     const auto query = ParseQuery(raw_query, true);
 
-    for (string_view word : query.minus_words)
+    for (const TermId term : query.minus_terms)
     {
-        if (word_to_document_freqs_.count(word) == 0)
+        if (ContainsTerm(term, document_index))
         {
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id))
-        {
-            return {matched_words, documents_.at(document_id).status};
+            return {matched_words, documents_[document_index].status};
         }
     }
 
-    for (string_view word : query.plus_words)
+    for (const TermId term : query.plus_terms)
     {
-        if (word_to_document_freqs_.count(word) == 0)
-        {
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id))
+        if (ContainsTerm(term, document_index))
         {
-            matched_words.push_back(word);
+            matched_words.push_back(dictionary_.GetWord(term));
         }
     }
-    return {matched_words, documents_.at(document_id).status};
+    sort(matched_words.begin(), matched_words.end());
+    return {matched_words, documents_[document_index].status};
 }
 
 MatchTuple SearchServer::MatchDocument(const execution::parallel_policy &, string_view raw_query,
                                        int document_id) const
 {
-    if ((document_id < 0) || (documents_.count(document_id) <= 0))
-    {
-        throw out_of_range("Invalid document_id"s);
-    }
+    const DocumentIndex document_index = GetDocumentIndex(document_id);
     if (!IsValidWord(raw_query))
     {
         throw invalid_argument("Invalid query");
@@ -178,51 +451,394 @@ MatchTuple SearchServer::MatchDocument(const execution::parallel_policy &, strin
 
     const auto query = ParseQuery(raw_query, false);
 
-    if (any_of(execution::par, query.minus_words.begin(), query.minus_words.end(), [this, &document_id](string_view word)
-               { return (word_to_document_freqs_.count(word) != 0 && word_to_document_freqs_.at(word).count(document_id)); }))
+    if (any_of(execution::par, query.minus_terms.begin(), query.minus_terms.end(), [this, document_index](TermId term)
+               { return ContainsTerm(term, document_index); }))
     {
-        return {vector<string_view>{}, documents_.at(document_id).status};
+        return {vector<string_view>{}, documents_[document_index].status};
     }
 
-    vector<string_view> matched_words(query.plus_words.size());
+    vector<TermId> matched_terms(query.plus_terms.size());
 
-    auto words_end = copy_if(execution::par, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(), [this, &document_id](string_view word)
-                             { return (word_to_document_freqs_.count(word) != 0 && word_to_document_freqs_.at(word).count(document_id)); });
+    auto terms_end = copy_if(execution::par, query.plus_terms.begin(), query.plus_terms.end(), matched_terms.begin(), [this, document_index](TermId term)
+                             { return ContainsTerm(term, document_index); });
 
-    sort(matched_words.begin(), words_end);
-    auto last_unique = unique(matched_words.begin(), words_end);
+    vector<string_view> matched_words(distance(matched_terms.begin(), terms_end));
+    transform(matched_terms.begin(), terms_end, matched_words.begin(), [this](TermId term)
+              { return dictionary_.GetWord(term); });
+
+    sort(matched_words.begin(), matched_words.end());
+    auto last_unique = unique(matched_words.begin(), matched_words.end());
     matched_words.erase(last_unique, matched_words.end());
 
-    return {matched_words, documents_.at(document_id).status};
+    return {matched_words, documents_[document_index].status};
+}
+
+void SearchServer::SetQueryEvaluation(QueryEvaluation query_evaluation)
+{
+    // engines may sum relevances in a different order, so results computed by the other one are dropped
+    if (query_evaluation != query_evaluation_)
+    {
+        ++index_generation_;
+    }
+    query_evaluation_ = query_evaluation;
 }
 
-bool SearchServer::IsStopWord(string_view word) const
+QueryEvaluation SearchServer::GetQueryEvaluation() const
 {
-    return stop_words_.count(word) > 0;
+    return query_evaluation_;
 }
 
-bool SearchServer::IsValidWord(string_view word)
+void SearchServer::SetAutoCompaction(bool is_enabled)
+{
+    is_auto_compaction_enabled_ = is_enabled;
+}
+
+bool SearchServer::GetAutoCompaction() const
+{
+    return is_auto_compaction_enabled_;
+}
+
+void SearchServer::SetQueryCacheCapacity(size_t capacity)
+{
+    query_cache_ = capacity > 0 ? make_unique<QueryResultCache>(capacity) : nullptr;
+}
+
+QueryCacheStats SearchServer::GetQueryCacheStats() const
+{
+    return query_cache_ ? query_cache_->GetStats() : QueryCacheStats{};
+}
+
+void SearchServer::SetExecutor(shared_ptr<ThreadPool> executor, size_t min_range_document_count)
+{
+    if (min_range_document_count == 0)
+    {
+        throw invalid_argument("Range must hold at least one document"s);
+    }
+    executor_ = move(executor);
+    min_range_document_count_ = min_range_document_count;
+}
+
+const shared_ptr<ThreadPool> &SearchServer::GetExecutor() const
+{
+    return executor_;
+}
+
+size_t SearchServer::GetSegmentCount() const
+{
+    return segments_.size() + (active_segment_.GetDocumentCount() > 0 ? 1 : 0);
+}
+
+void SearchServer::Compact()
+{
+    // the merge reads segments about to be replaced
+    FinishMerge();
+
+    // documents and terms keep their relative order, so remapped posting lists and forward index ranges stay sorted
+    const DocumentIndex no_document = numeric_limits<DocumentIndex>::max();
+    vector<DocumentIndex> new_document_indexes(documents_.size(), no_document);
+    for (const auto &[document_id, document_index] : id_to_document_index_)
+    {
+        new_document_indexes[document_index] = 0;
+    }
+    DocumentIndex document_count = 0;
+    for (DocumentIndex &new_document_index : new_document_indexes)
+    {
+        if (new_document_index != no_document)
+        {
+            new_document_index = document_count++;
+        }
+    }
+
+    // stop words keep the first ids, other words survive while a document has them
+    TermDictionary dictionary;
+    vector<TermId> new_terms(dictionary_.GetSize(), TermDictionary::NO_TERM);
+    for (TermId term = 0; term < dictionary_.GetSize(); ++term)
+    {
+        if (IsStopTerm(term) || (term < term_document_freqs_.size() && term_document_freqs_[term] > 0))
+        {
+            new_terms[term] = dictionary.Intern(dictionary_.GetWord(term));
+        }
+    }
+    const size_t term_count = dictionary.GetSize();
+
+    vector<DocumentData> documents;
+    documents.reserve(document_count);
+    vector<DocumentTerm> document_terms;
+    for (DocumentIndex document_index = 0; document_index < documents_.size(); ++document_index)
+    {
+        if (new_document_indexes[document_index] == no_document)
+        {
+            continue;
+        }
+        DocumentData document = documents_[document_index];
+        const uint64_t terms_begin = document.terms_begin;
+        document.terms_begin = document_terms.size();
+        for (size_t i = 0; i < document.term_count; ++i)
+        {
+            const DocumentTerm &document_term = document_terms_[terms_begin + i];
+            document_terms.push_back({new_terms[document_term.term], document_term.term_count});
+        }
+        documents.push_back(document);
+    }
+
+    // removal left the bounds loose, they are exact again after the rebuild
+    vector<PostingList> term_postings(term_count);
+    vector<double> term_max_freqs(term_count, 0.0);
+    const auto append_segment = [&](const IndexSegment &segment)
+    {
+        segment.ForEachTerm([&](TermId term, const PostingList &postings)
+                            {
+                                // only removed documents had the word
+                                if (new_terms[term] == TermDictionary::NO_TERM)
+                                {
+                                    return;
+                                }
+                                PostingList &list = term_postings[new_terms[term]];
+                                double &max_freq = term_max_freqs[new_terms[term]];
+                                postings.ForEach([&](DocumentIndex document_index, uint32_t term_count)
+                                                 {
+                                                     const DocumentIndex new_document_index = new_document_indexes[document_index];
+                                                     if (new_document_index != no_document)
+                                                     {
+                                                         list.Append(new_document_index, term_count);
+                                                         max_freq = max(max_freq, term_count * documents[new_document_index].inv_word_count);
+                                                     } });
+                            });
+    };
+    for (const auto &segment : segments_)
+    {
+        append_segment(*segment);
+    }
+    append_segment(active_segment_);
+
+    vector<uint32_t> term_document_freqs(term_count);
+    vector<double> term_log_document_freqs(term_count);
+    for (TermId term = 0; term < new_terms.size(); ++term)
+    {
+        if (new_terms[term] != TermDictionary::NO_TERM && term < term_document_freqs_.size())
+        {
+            term_document_freqs[new_terms[term]] = term_document_freqs_[term];
+            term_log_document_freqs[new_terms[term]] = term_log_document_freqs_[term];
+        }
+    }
+
+    dictionary_ = move(dictionary);
+    segments_.clear();
+    if (document_count > 0)
+    {
+        segments_.push_back(make_shared<IndexSegment>(0, document_count, move(term_postings)));
+    }
+    active_segment_ = IndexSegment(document_count);
+    term_document_freqs_ = move(term_document_freqs);
+    term_log_document_freqs_ = move(term_log_document_freqs);
+    term_max_freqs_ = MappedArray<double>();
+    term_max_freqs_.Mutable() = move(term_max_freqs);
+    documents_ = MappedArray<DocumentData>();
+    documents_.Mutable() = move(documents);
+    document_terms_ = MappedArray<DocumentTerm>();
+    document_terms_.Mutable() = move(document_terms);
+    for (auto &[document_id, document_index] : id_to_document_index_)
+    {
+        document_index = new_document_indexes[document_index];
+    }
+    removed_documents_ = vector<bool>();
+    // every array is owned now, the mapping is not needed any more
+    snapshot_file_.reset();
+    ++index_generation_;
+}
+
+size_t SearchServer::GetMemoryUsage() const
+{
+    size_t memory_usage = sizeof(*this) + dictionary_.GetMemoryUsage() + active_segment_.GetMemoryUsage() +
+                          segments_.capacity() * sizeof(shared_ptr<const IndexSegment>) +
+                          term_document_freqs_.capacity() * sizeof(uint32_t) + term_max_freqs_.GetMemoryUsage() +
+                          term_log_document_freqs_.capacity() * sizeof(double) + documents_.GetMemoryUsage() +
+                          document_terms_.GetMemoryUsage() + removed_documents_.capacity() / 8;
+    for (const auto &segment : segments_)
+    {
+        memory_usage += segment->GetMemoryUsage();
+    }
+    // a node holds its element and two or three pointers, the hash map adds a bucket array
+    memory_usage += id_to_document_index_.size() * (sizeof(pair<const int, DocumentIndex>) + 2 * sizeof(void *)) +
+                    id_to_document_index_.bucket_count() * sizeof(void *);
+    memory_usage += document_ids_.size() * (sizeof(int) + 4 * sizeof(void *));
+    return memory_usage;
+}
+
+void SearchServer::SaveSnapshot(const string &path) const
 {
-    return none_of(word.begin(), word.end(), [](char c)
-                   { return c >= '\0' && c < ' '; });
+    SnapshotWriter writer(path, 13);
+    const SnapshotMeta meta{stop_term_count_, 0};
+    writer.BeginSection(SnapshotSection::SERVER_META);
+    writer.WriteArray(&meta, 1);
+    dictionary_.SaveSnapshot(writer);
+    // the file keeps one list per term, so segments are concatenated; postings of removed
+    // documents are left out, their documents are saved without terms
+    vector<PostingList> term_postings(term_max_freqs_.size());
+    const auto append_segment = [this, &term_postings](const IndexSegment &segment)
+    {
+        segment.ForEachTerm([this, &term_postings](TermId term, const PostingList &postings)
+                            {
+                                if (removed_documents_.empty())
+                                {
+                                    term_postings[term].Append(postings);
+                                    return;
+                                }
+                                postings.ForEach([this, &list = term_postings[term]](DocumentIndex document_index, uint32_t term_count)
+                                                 {
+                                                     if (!IsRemoved(document_index))
+                                                     {
+                                                         list.Append(document_index, term_count);
+                                                     } });
+                            });
+    };
+    for (const auto &segment : segments_)
+    {
+        append_segment(*segment);
+    }
+    append_segment(active_segment_);
+    PostingList::SaveSnapshot(term_postings, writer);
+    writer.BeginSection(SnapshotSection::TERM_MAX_FREQS);
+    writer.WriteArray(term_max_freqs_.data(), term_max_freqs_.size());
+    writer.BeginSection(SnapshotSection::DOCUMENTS);
+    writer.WriteArray(documents_.data(), documents_.size());
+    writer.BeginSection(SnapshotSection::DOCUMENT_TERMS);
+    writer.WriteArray(document_terms_.data(), document_terms_.size());
+    // sorted by id, so loading rebuilds document_ids_ without rebalancing
+    writer.BeginSection(SnapshotSection::DOCUMENT_IDS);
+    for (const int document_id : document_ids_)
+    {
+        const SnapshotDocumentId document{document_id, id_to_document_index_.at(document_id)};
+        writer.WriteArray(&document, 1);
+    }
+    writer.Finish();
 }
 
-vector<string_view> SearchServer::SplitIntoWordsViewNoStop(string_view text) const
+void SearchServer::LoadSnapshot(const string &path)
 {
-    vector<string_view> words;
-    for (string_view word : SplitIntoWordsView(text))
+    // everything is read and checked first, so a bad snapshot leaves the server untouched
+    const SnapshotReader reader(path);
+    const auto [metas, meta_count] = reader.GetArray<SnapshotMeta>(SnapshotSection::SERVER_META);
+    TermDictionary dictionary;
+    dictionary.LoadSnapshot(reader);
+    vector<PostingList> term_to_document_freqs = PostingList::LoadSnapshot(reader);
+    const auto [term_max_freqs, term_count] = reader.GetArray<double>(SnapshotSection::TERM_MAX_FREQS);
+    const auto [documents, document_count] = reader.GetArray<DocumentData>(SnapshotSection::DOCUMENTS);
+    const auto [document_terms, document_term_count] = reader.GetArray<DocumentTerm>(SnapshotSection::DOCUMENT_TERMS);
+    const auto [document_ids, document_id_count] = reader.GetArray<SnapshotDocumentId>(SnapshotSection::DOCUMENT_IDS);
+
+    bool is_valid = meta_count == 1 && metas[0].stop_term_count <= dictionary.GetSize() &&
+                    term_to_document_freqs.size() == term_count && term_count <= dictionary.GetSize() &&
+                    document_count <= numeric_limits<DocumentIndex>::max();
+    for (size_t i = 0; is_valid && i < document_count; ++i)
+    {
+        const DocumentData &document = documents[i];
+        is_valid = document.terms_begin <= document_term_count && document.term_count <= document_term_count - document.terms_begin;
+        for (size_t j = 0; is_valid && j < document.term_count; ++j)
+        {
+            is_valid = document_terms[document.terms_begin + j].term < term_count;
+        }
+    }
+    // documents no id points to were removed before the save
+    vector<bool> removed_documents(document_count, true);
+    for (size_t i = 0; is_valid && i < document_id_count; ++i)
     {
-        if (!IsValidWord(word))
+        is_valid = document_ids[i].id >= 0 && document_ids[i].document_index < document_count && (i == 0 || document_ids[i - 1].id < document_ids[i].id) &&
+                   removed_documents[document_ids[i].document_index];
+        if (is_valid)
         {
-            string not_valid_word(word);
-            throw invalid_argument("Word " + not_valid_word + " is invalid");
+            removed_documents[document_ids[i].document_index] = false;
         }
-        if (!IsStopWord(word))
+    }
+    if (!is_valid)
+    {
+        throw runtime_error("Snapshot "s + path + " is corrupted"s);
+    }
+
+    unordered_map<int, DocumentIndex> id_to_document_index;
+    id_to_document_index.reserve(document_id_count);
+    set<int> ids;
+    for (size_t i = 0; i < document_id_count; ++i)
+    {
+        id_to_document_index.emplace(document_ids[i].id, document_ids[i].document_index);
+        ids.insert(ids.end(), document_ids[i].id);
+    }
+
+    // the merge may read the mapping about to be replaced
+    FinishMerge();
+    dictionary_ = move(dictionary);
+    stop_term_count_ = metas[0].stop_term_count;
+    // terms interned after the last document was added (stop words only) have no postings yet
+    term_document_freqs_.assign(dictionary_.GetSize(), 0);
+    for (size_t term = 0; term < term_to_document_freqs.size(); ++term)
+    {
+        term_document_freqs_[term] = static_cast<uint32_t>(term_to_document_freqs[term].size());
+    }
+    segments_.clear();
+    // the removed count FinishRemoval weighs compaction by follows from the ids left
+    if (document_id_count < document_count)
+    {
+        removed_documents_ = move(removed_documents);
+    }
+    else
+    {
+        removed_documents_.clear();
+    }
+    if (document_count > 0)
+    {
+        segments_.push_back(make_shared<IndexSegment>(0, static_cast<DocumentIndex>(document_count), move(term_to_document_freqs)));
+    }
+    active_segment_ = IndexSegment(static_cast<DocumentIndex>(document_count));
+    term_max_freqs_ = MappedArray<double>(term_max_freqs, term_count);
+    if (term_count < dictionary_.GetSize())
+    {
+        term_max_freqs_.Mutable().resize(dictionary_.GetSize());
+    }
+    documents_ = MappedArray<DocumentData>(documents, document_count);
+    document_terms_ = MappedArray<DocumentTerm>(document_terms, document_term_count);
+    id_to_document_index_ = move(id_to_document_index);
+    document_ids_ = move(ids);
+    snapshot_file_ = reader.GetFile();
+    term_log_document_freqs_.resize(dictionary_.GetSize());
+    for (TermId term = 0; term < dictionary_.GetSize(); ++term)
+    {
+        UpdateTermLogDocumentFreq(term);
+    }
+    UpdateLogDocumentCount();
+    ++index_generation_;
+}
+
+bool SearchServer::IsStopTerm(TermId term) const
+{
+    return term < stop_term_count_;
+}
+
+bool SearchServer::IsValidWord(string_view word)
+{
+    return !HasControlCharacters(word);
+}
+
+vector<SearchServer::TermId> SearchServer::InternWordsNoStop(string_view text)
+{
+    thread_local vector<string_view> words;
+    const size_t first_invalid_word = SplitIntoWordsView(text, words);
+    // validate the whole document first so a rejected one leaves no terms behind
+    if (first_invalid_word != words.size())
+    {
+        string not_valid_word(words[first_invalid_word]);
+        throw invalid_argument("Word " + not_valid_word + " is invalid");
+    }
+    vector<TermId> terms;
+    terms.reserve(words.size());
+    for (string_view word : words)
+    {
+        const TermId term = dictionary_.Intern(word);
+        if (!IsStopTerm(term))
         {
-            words.push_back(word);
+            terms.push_back(term);
         }
     }
-    return words;
+    return terms;
 }
 
 int SearchServer::ComputeAverageRating(const vector<int> &ratings)
@@ -231,28 +847,135 @@ int SearchServer::ComputeAverageRating(const vector<int> &ratings)
     return rating_sum / static_cast<int>(ratings.size());
 }
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const
+SearchServer::DocumentIndex SearchServer::GetDocumentIndex(int document_id) const
+{
+    const auto it = id_to_document_index_.find(document_id);
+    if (it == id_to_document_index_.end())
+    {
+        throw out_of_range("Invalid document_id"s);
+    }
+    return it->second;
+}
+
+const IndexSegment &SearchServer::FindSegment(DocumentIndex document_index) const
+{
+    if (document_index >= active_segment_.GetFirstDocumentIndex())
+    {
+        return active_segment_;
+    }
+    const auto it = upper_bound(segments_.begin(), segments_.end(), document_index,
+                                [](DocumentIndex index, const shared_ptr<const IndexSegment> &segment)
+                                { return index < segment->GetFirstDocumentIndex(); });
+    return **prev(it);
+}
+
+TermPostings SearchServer::GetTermPostings(TermId term) const
+{
+    TermPostings postings;
+    for (const auto &segment : segments_)
+    {
+        postings.Add(segment->FindPostings(term));
+    }
+    postings.Add(active_segment_.FindPostings(term));
+    return postings;
+}
+
+bool SearchServer::ContainsTerm(TermId term, DocumentIndex document_index) const
+{
+    const PostingList *postings = FindSegment(document_index).FindPostings(term);
+    return postings != nullptr && postings->Contains(document_index);
+}
+
+void SearchServer::SealActiveSegment()
+{
+    IndexSegment next_segment = active_segment_.Seal(static_cast<DocumentIndex>(documents_.size()));
+    if (active_segment_.GetDocumentCount() > 0)
+    {
+        segments_.push_back(make_shared<IndexSegment>(move(active_segment_)));
+    }
+    active_segment_ = move(next_segment);
+}
+
+size_t SearchServer::GetSegmentTier(const IndexSegment &segment)
+{
+    size_t tier = 0;
+    for (size_t tier_size = SEGMENT_DOCUMENT_COUNT * SEGMENT_MERGE_FACTOR; segment.GetDocumentCount() >= tier_size;
+         tier_size *= SEGMENT_MERGE_FACTOR)
+    {
+        ++tier;
+    }
+    return tier;
+}
+
+void SearchServer::ScheduleMerge()
+{
+    if (merge_.valid())
+    {
+        if (merge_.wait_for(chrono::seconds(0)) != future_status::ready)
+        {
+            return;
+        }
+        FinishMerge();
+    }
+    // newest segments first: they are the small ones that show up most often
+    for (size_t last = segments_.size(); last >= SEGMENT_MERGE_FACTOR; --last)
+    {
+        const size_t first = last - SEGMENT_MERGE_FACTOR;
+        const size_t tier = GetSegmentTier(*segments_[first]);
+        if (all_of(segments_.begin() + first + 1, segments_.begin() + last, [tier](const shared_ptr<const IndexSegment> &segment)
+                   { return GetSegmentTier(*segment) == tier; }))
+        {
+            vector<shared_ptr<const IndexSegment>> merged_segments(segments_.begin() + first, segments_.begin() + last);
+            merge_first_segment_ = first;
+            merge_ = async(launch::async, [merged_segments = move(merged_segments)]()
+                           { return IndexSegment::Merge(merged_segments); });
+            return;
+        }
+    }
+}
+
+void SearchServer::FinishMerge()
+{
+    if (!merge_.valid())
+    {
+        return;
+    }
+    auto merged = make_shared<IndexSegment>(merge_.get());
+    const auto first = segments_.begin() + merge_first_segment_;
+    *first = move(merged);
+    segments_.erase(first + 1, first + SEGMENT_MERGE_FACTOR);
+}
+
+string_view SearchServer::CheckQueryWord(string_view text, bool is_valid, bool &is_minus)
 {
     if (text.empty())
     {
         throw invalid_argument("Query word is empty");
     }
     string_view word = text;
-    bool is_minus = false;
+    is_minus = false;
     if (word[0] == '-')
     {
         is_minus = true;
         word = word.substr(1);
     }
-    if (word.empty() || word[0] == '-' || !IsValidWord(word))
+    if (word.empty() || word[0] == '-' || !is_valid)
     {
         string not_valid_text(text);
         throw invalid_argument("Query word " + not_valid_text + " is invalid");
     }
-    return {word, is_minus, IsStopWord(word)};
+    return word;
+}
+
+SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text, bool is_valid) const
+{
+    bool is_minus = false;
+    const string_view word = CheckQueryWord(text, is_valid, is_minus);
+    const TermId term = dictionary_.Find(word);
+    return {term, is_minus, term != TermDictionary::NO_TERM && IsStopTerm(term)};
 }
 
-void SearchServer::SortUnique(vector<string_view> &vector) const
+void SearchServer::SortUnique(vector<TermId> &vector) const
 {
     sort(execution::par, vector.begin(), vector.end());
     auto last_unique = unique(execution::par, vector.begin(), vector.end());
@@ -261,36 +984,207 @@ void SearchServer::SortUnique(vector<string_view> &vector) const
 
 SearchServer::Query SearchServer::ParseQuery(string_view text, bool sort_request) const
 {
+    QueryStageTimer parse_timer(QueryStage::PARSE);
     SearchServer::Query result;
-    vector<string_view> words = SplitIntoWordsView(text);
+    thread_local vector<string_view> words;
+    const size_t first_invalid_word = SplitIntoWordsView(text, words);
 
-    for (string_view word : words)
+    for (size_t i = 0; i < words.size(); ++i)
     {
-        auto query_word = ParseQueryWord(word);
-        if (!query_word.is_stop)
+        const auto query_word = ParseQueryWord(words[i], i != first_invalid_word);
+        // words missing from the dictionary cannot match any document
+        if (!query_word.is_stop && query_word.term != TermDictionary::NO_TERM)
         {
             if (query_word.is_minus)
             {
-                result.minus_words.push_back(move(query_word.data));
+                result.minus_terms.push_back(query_word.term);
             }
             else
             {
-                result.plus_words.push_back(move(query_word.data));
+                result.plus_terms.push_back(query_word.term);
             }
         }
     }
     if (sort_request)
     {
-        SortUnique(result.minus_words);
-        SortUnique(result.plus_words);
+        SortUnique(result.minus_terms);
+        SortUnique(result.plus_terms);
     }
 
     return result;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(string_view word) const
+void SearchServer::DescribeQuery(string_view raw_query, const Query &query, QueryProfile &profile) const
+{
+    for (size_t position = 0; position < query.plus_terms.size(); ++position)
+    {
+        const TermId term = query.plus_terms[position];
+        profile.plus_terms.push_back({string(dictionary_.GetWord(term)), GetTermPostings(term).size(), GetInverseDocumentFreq(query, position)});
+    }
+    for (const TermId term : query.minus_terms)
+    {
+        profile.minus_terms.push_back({string(dictionary_.GetWord(term)), GetTermPostings(term).size(), ComputeTermInverseDocumentFreq(term)});
+    }
+    // the query has been parsed already, so every word is valid
+    for (const string_view word : SplitIntoWordsView(raw_query))
+    {
+        const auto query_word = ParseQueryWord(word, true);
+        if (query_word.is_stop)
+        {
+            profile.stop_words.emplace_back(word);
+        }
+        else if (query_word.term == TermDictionary::NO_TERM)
+        {
+            profile.unknown_words.emplace_back(word);
+        }
+    }
+}
+
+SearchServer::Query SearchServer::ParseQuery(const QueryWords &query_words, const CorpusStatistics &statistics) const
 {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+    QueryStageTimer parse_timer(QueryStage::PARSE);
+    struct RankedTerm
+    {
+        uint32_t rank;
+        string_view word;
+        TermId term;
+        int document_freq;
+    };
+    vector<RankedTerm> ranked_terms;
+    ranked_terms.reserve(query_words.plus_words.size());
+    for (size_t i = 0; i < query_words.plus_words.size(); ++i)
+    {
+        const string_view word = query_words.plus_words[i];
+        const TermId term = dictionary_.Find(word);
+        if (term != TermDictionary::NO_TERM && !IsStopTerm(term))
+        {
+            ranked_terms.push_back({statistics.words[i].rank, word, term, statistics.words[i].document_freq});
+        }
+    }
+    sort(ranked_terms.begin(), ranked_terms.end(), [](const RankedTerm &lhs, const RankedTerm &rhs)
+         { return tie(lhs.rank, lhs.word) < tie(rhs.rank, rhs.word); });
+
+    Query query;
+    // the same expression UpdateLogDocumentCount and UpdateTermLogDocumentFreq use, so scores match bit for bit
+    const double log_document_count = statistics.document_count > 0 ? log(statistics.document_count) : 0.0;
+    for (const RankedTerm &ranked_term : ranked_terms)
+    {
+        query.plus_terms.push_back(ranked_term.term);
+        query.inverse_document_freqs.push_back(log_document_count - (ranked_term.document_freq > 0 ? log(ranked_term.document_freq) : 0.0));
+    }
+    for (const string_view word : query_words.minus_words)
+    {
+        const TermId term = dictionary_.Find(word);
+        if (term != TermDictionary::NO_TERM && !IsStopTerm(term))
+        {
+            query.minus_terms.push_back(term);
+        }
+    }
+    sort(query.minus_terms.begin(), query.minus_terms.end());
+    return query;
+}
+
+QueryWords SearchServer::ParseQueryWords(string_view raw_query)
+{
+    QueryWords query_words;
+    thread_local vector<string_view> words;
+    const size_t first_invalid_word = SplitIntoWordsView(raw_query, words);
+    for (size_t i = 0; i < words.size(); ++i)
+    {
+        bool is_minus = false;
+        const string_view word = CheckQueryWord(words[i], i != first_invalid_word, is_minus);
+        if (is_minus)
+        {
+            query_words.minus_words.push_back(word);
+        }
+        else
+        {
+            query_words.plus_words.push_back(word);
+        }
+    }
+    const auto sort_unique = [](vector<string_view> &words)
+    {
+        sort(words.begin(), words.end());
+        words.erase(unique(words.begin(), words.end()), words.end());
+    };
+    sort_unique(query_words.plus_words);
+    sort_unique(query_words.minus_words);
+    return query_words;
+}
+
+vector<int> SearchServer::GetWordDocumentFreqs(const QueryWords &query_words) const
+{
+    vector<int> document_freqs;
+    document_freqs.reserve(query_words.plus_words.size());
+    for (const string_view word : query_words.plus_words)
+    {
+        const TermId term = dictionary_.Find(word);
+        document_freqs.push_back(term != TermDictionary::NO_TERM && !IsStopTerm(term) ? term_document_freqs_[term] : 0);
+    }
+    return document_freqs;
+}
+
+string SearchServer::MakeQueryCacheKey(const Query &query, DocumentStatus status, size_t max_count)
+{
+    // raw bytes: status, max_count, plus term count, then the plus and minus terms
+    const uint64_t header[] = {static_cast<uint64_t>(status), max_count, query.plus_terms.size()};
+    string key(reinterpret_cast<const char *>(header), sizeof(header));
+    key.append(reinterpret_cast<const char *>(query.plus_terms.data()), query.plus_terms.size() * sizeof(TermId));
+    key.append(reinterpret_cast<const char *>(query.minus_terms.data()), query.minus_terms.size() * sizeof(TermId));
+    return key;
+}
+
+size_t SearchServer::GetParallelRangeCount() const
+{
+    const size_t thread_count = executor_ ? executor_->GetThreadCount() : max(1u, thread::hardware_concurrency());
+    return clamp<size_t>(documents_.size() / min_range_document_count_, 1, thread_count * 4);
+}
+
+void SearchServer::UpdateTermLogDocumentFreq(TermId term)
+{
+    const size_t document_freq = term_document_freqs_[term];
+    // terms without documents are never scored
+    term_log_document_freqs_[term] = document_freq > 0 ? log(document_freq) : 0.0;
+}
+
+void SearchServer::UpdateLogDocumentCount()
+{
+    log_document_count_ = GetDocumentCount() > 0 ? log(GetDocumentCount()) : 0.0;
+}
+
+ostream &operator<<(ostream &out, const QueryProfile &profile)
+{
+    const auto print_terms = [&out](string_view name, const vector<QueryProfile::Term> &terms)
+    {
+        out << name;
+        for (const auto &term : terms)
+        {
+            out << ' ' << term.word << " (postings "s << term.posting_count << ", idf "s << term.inverse_document_freq << ')';
+        }
+        out << '\n';
+    };
+    const auto print_words = [&out](string_view name, const vector<string> &words)
+    {
+        out << name;
+        for (const string &word : words)
+        {
+            out << ' ' << word;
+        }
+        out << '\n';
+    };
+    print_terms("plus words:"sv, profile.plus_terms);
+    print_terms("minus words:"sv, profile.minus_terms);
+    print_words("stop words:"sv, profile.stop_words);
+    print_words("unknown words:"sv, profile.unknown_words);
+    out << "documents scored "s << profile.documents_scored << ", eliminated by minus words "s << profile.documents_eliminated
+        << ", filtered "s << profile.documents_filtered << '\n';
+    out << "stage time, us:"s;
+    for (size_t stage = 0; stage < QUERY_STAGE_COUNT; ++stage)
+    {
+        const auto duration = profile.GetStageDuration(static_cast<QueryStage>(stage));
+        out << ' ' << GetQueryStageName(static_cast<QueryStage>(stage)) << ' ' << duration.count() / 1000.0;
+    }
+    return out << '\n';
 }
 
 void AddDocument(SearchServer &search_server, int document_id, string_view document,
@@ -320,7 +1214,6 @@ void FindTopDocuments(const SearchServer &search_server, string_view raw_query)
     {
         cout << "Error is seaching: "s << e.what() << endl;
     }
-    LOG_DURATION_STREAM("Find top documents"s, cerr);
 }
 
 void MatchDocuments(const SearchServer &search_server, string_view query)
@@ -328,13 +1221,13 @@ void MatchDocuments(const SearchServer &search_server, string_view query)
     try
     {
         cout << "Matching for request: "s << query << endl;
-        const int document_count = search_server.GetDocumentCount();
-        for (int index = 0; index < document_count; ++index)
+        // printed by id, documents are matched in the order they were added
+        map<int, MatchTuple> matches;
+        search_server.MatchAllDocuments(execution::seq, query, [&matches](int document_id, const vector<string_view> &words, DocumentStatus status)
+                                        { matches.emplace(document_id, MatchTuple{words, status}); });
+        for (const auto &[document_id, match] : matches)
         {
-            auto it = search_server.begin();
-            advance(it, index);
-            const int document_id = *it;
-            auto [words, status] = search_server.MatchDocument(query, document_id);
+            const auto &[words, status] = match;
             PrintMatchDocumentResult(document_id, words, status);
         }
     }
@@ -342,5 +1235,4 @@ void MatchDocuments(const SearchServer &search_server, string_view query)
     {
         cout << "Error in matchig request "s << query << ": "s << e.what() << endl;
     }
-    LogDuration guard("Match document", cerr);
 }
\ No newline at end of file
@@ -2,16 +2,27 @@
 
 #include "document.h"
 #include "string_processing.h"
-#include "log_duration.h"
-#include "concurrent_map.h"
+#include "metrics.h"
+#include "term_dictionary.h"
+#include "posting_list.h"
+#include "index_segment.h"
+#include "thread_pool.h"
+#include "top_documents.h"
+#include "mapped_array.h"
+#include "snapshot.h"
+#include "query_cache.h"
 
 #include <string>
 #include <string_view>
 #include <vector>
 #include <stdexcept>
 #include <map>
+#include <unordered_map>
 #include <set>
 #include <tuple>
+#include <cstddef>
+#include <iterator>
+#include <utility>
 #include <algorithm>
 #include <cmath>
 #include <iostream>
@@ -19,12 +30,99 @@
 #include <functional>
 #include <deque>
 #include <type_traits>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <thread>
+#include <future>
+#include <chrono>
+#include <array>
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 
-const int BUCKETS_COUNT = 100;
+// parallel scoring does not split the index into ranges smaller than this
+const std::size_t MIN_PARALLEL_RANGE_DOCUMENT_COUNT = 4096;
 
-const double EPSILON = 1e-6;
+// documents the mutable segment takes before it is sealed
+const std::size_t SEGMENT_DOCUMENT_COUNT = 4096;
+
+// size-tiered merging: this many adjacent segments of one tier are merged into one of the next tier
+const std::size_t SEGMENT_MERGE_FACTOR = 4;
+
+// with automatic compaction on, removal compacts the index once removed documents outnumber the
+// ones left and reach this count
+const std::size_t COMPACTION_MIN_REMOVED_DOCUMENT_COUNT = 4096;
+
+// a query split and checked once, so servers with the same stop words can run it without
+// parsing it again; words point into the raw query, stop words are kept, each list is
+// sorted and unique
+struct QueryWords
+{
+    std::vector<std::string_view> plus_words;
+    std::vector<std::string_view> minus_words;
+};
+
+// numbers of a corpus the index is a part of, so a query can be scored as if it ran on the
+// whole corpus; words are summed in rank order, a single index sums them in term id order
+struct CorpusStatistics
+{
+    struct Word
+    {
+        int document_freq = 0;
+        std::uint32_t rank = std::numeric_limits<std::uint32_t>::max();
+    };
+
+    int document_count = 0;
+    // by plus word of the QueryWords the statistics were gathered for
+    std::vector<Word> words;
+};
+
+// what a query from FindTopDocumentsExplained went through
+struct QueryProfile
+{
+    struct Term
+    {
+        std::string word;
+        // postings of removed documents count until the index is compacted
+        std::size_t posting_count = 0;
+        double inverse_document_freq = 0.0;
+    };
+
+    // plus words in the order their relevance is summed, minus words by term
+    std::vector<Term> plus_terms;
+    std::vector<Term> minus_terms;
+    // as written in the query, in query order
+    std::vector<std::string> stop_words;
+    // words no document has, they cannot match anything
+    std::vector<std::string> unknown_words;
+    // documents a plus word matched
+    std::size_t documents_scored = 0;
+    // scored documents that had a minus word
+    std::size_t documents_eliminated = 0;
+    // the rest of the scored documents the predicate rejected
+    std::size_t documents_filtered = 0;
+    // wall time by QueryStage; nothing is materialized, that stage stays zero
+    std::array<std::chrono::nanoseconds, QUERY_STAGE_COUNT> stage_durations{};
+
+    std::chrono::nanoseconds GetStageDuration(QueryStage stage) const
+    {
+        return stage_durations[static_cast<std::size_t>(stage)];
+    }
+};
+
+std::ostream &operator<<(std::ostream &out, const QueryProfile &profile);
+
+struct ExplainedDocuments
+{
+    std::vector<Document> documents;
+    QueryProfile profile;
+};
+
+enum class QueryEvaluation
+{
+    EXHAUSTIVE,
+    MAX_SCORE,
+};
 
 class SearchServer
 {
@@ -39,120 +137,481 @@ public:
     void AddDocument(int document_id, std::string_view document, DocumentStatus status,
                      const std::vector<int> &ratings);
 
+    // adds the documents in order, as repeated AddDocument calls would; on an invalid document
+    // the ones before it stay added and the same invalid_argument is thrown
+    template <typename ExecutionPolicy, typename DocumentRange>
+    void AddDocuments(const ExecutionPolicy &policy, const DocumentRange &documents);
+
+    template <typename DocumentRange>
+    void AddDocuments(const DocumentRange &documents);
+
+    // removal only marks the document, its postings stay until the index is compacted;
+    // with automatic compaction on it may call Compact, see there
     void RemoveDocument(int document_id);
 
     void RemoveDocument(const std::execution::sequenced_policy &, int document_id);
 
     void RemoveDocument(const std::execution::parallel_policy &, int document_id);
 
+    // removes all of them at once: frequencies and the document count are updated once per call
+    // and compaction is considered once; missing ids are skipped
+    void RemoveDocuments(const std::vector<int> &document_ids);
+
     template <typename ExecutionPolicy, typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(const ExecutionPolicy &policy, std::string_view raw_query,
-                                           DocumentPredicate document_predicate) const;
+                                           DocumentPredicate document_predicate,
+                                           std::size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
     template <typename ExecutionPolicy>
-    std::vector<Document> FindTopDocuments(const ExecutionPolicy &policy, std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy &policy, std::string_view raw_query, DocumentStatus status,
+                                           std::size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
     template <typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(const ExecutionPolicy &policy, std::string_view raw_query) const;
 
     template <typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(std::string_view raw_query,
-                                           DocumentPredicate document_predicate) const;
+                                           DocumentPredicate document_predicate,
+                                           std::size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
-    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                                           std::size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
     std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
 
+    // throws invalid_argument on the same queries FindTopDocuments does
+    static QueryWords ParseQueryWords(std::string_view raw_query);
+
+    // scores with the statistics of query_words instead of the index's own
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsWithStatistics(const ExecutionPolicy &policy, const QueryWords &query_words,
+                                                         const CorpusStatistics &statistics, DocumentPredicate document_predicate,
+                                                         std::size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    // FindTopDocuments with a profile of the query. It is always scored sequentially and
+    // exhaustively, past the query cache, with its own counting code, so FindTopDocuments pays
+    // nothing for it; results are the same as FindTopDocuments gives
+    template <typename DocumentPredicate>
+    ExplainedDocuments FindTopDocumentsExplained(std::string_view raw_query, DocumentPredicate document_predicate,
+                                                 std::size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    ExplainedDocuments FindTopDocumentsExplained(std::string_view raw_query, DocumentStatus status,
+                                                 std::size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    ExplainedDocuments FindTopDocumentsExplained(std::string_view raw_query) const;
+
+    // documents having each plus word, 0 for stop words and words the index does not know
+    std::vector<int> GetWordDocumentFreqs(const QueryWords &query_words) const;
+
     int GetDocumentCount() const;
 
     typename std::set<int>::const_iterator begin() const;
 
     typename std::set<int>::const_iterator end() const;
 
-    std::map<std::string_view, double> GetWordFrequencies(int document_id) const;
+    class WordFrequencies;
+
+    // a view of the document's entry in the forward index, nothing is copied; the words stay
+    // valid until Compact or LoadSnapshot, the frequencies only until the next change
+    WordFrequencies GetWordFrequencies(int document_id) const;
+
+    // term ids of the document's words without stop words, ascending; documents with the same
+    // words get the same terms until the index is compacted
+    void GetDocumentTerms(int document_id, std::vector<TermDictionary::TermId> &terms) const;
 
     using MatchTuple = std::tuple<std::vector<std::string_view>, DocumentStatus>;
 
+    // the words point into the dictionary and stay valid until Compact or LoadSnapshot,
+    // adding and removing documents leaves them alone
+
     MatchTuple MatchDocument(std::string_view raw_query, int document_id) const;
 
     MatchTuple MatchDocument(const std::execution::sequenced_policy &, std::string_view raw_query, int document_id) const;
 
     MatchTuple MatchDocument(const std::execution::parallel_policy &, std::string_view raw_query, int document_id) const;
 
+    // calls sink(document_id, words, status) for every document, with the words MatchDocument
+    // would return; the query is parsed once and posting lists are walked, not probed per document.
+    // Words point into the dictionary, as with MatchDocument, and the vector is reused.
+    // Documents come in the order they were added; under std::execution::par ranges of them are
+    // matched at once and the sink is called from several threads
+    template <typename ExecutionPolicy, typename MatchSink>
+    void MatchAllDocuments(const ExecutionPolicy &policy, std::string_view raw_query, MatchSink sink) const;
+
+    void SetQueryEvaluation(QueryEvaluation query_evaluation);
+
+    QueryEvaluation GetQueryEvaluation() const;
+
+    // caches results of the FindTopDocuments overloads that filter by status, predicates cannot
+    // be compared; any change of the index makes the cached results stale, 0 turns the cache off
+    void SetQueryCacheCapacity(std::size_t capacity);
+
+    QueryCacheStats GetQueryCacheStats() const;
+
+    // parallel queries split the index into ranges of at least min_range_document_count
+    // documents and run them on the pool, ProcessQueries runs its queries there too;
+    // without a pool std::execution::par is used
+    void SetExecutor(std::shared_ptr<ThreadPool> executor,
+                     std::size_t min_range_document_count = MIN_PARALLEL_RANGE_DOCUMENT_COUNT);
+
+    const std::shared_ptr<ThreadPool> &GetExecutor() const;
+
+    // sealed segments plus the mutable one, if it has documents
+    std::size_t GetSegmentCount() const;
+
+    // rebuilds the index without removed documents: drops their postings and the words no
+    // document has any more, and renumbers documents and terms densely. The dictionary is
+    // replaced, so words returned by MatchDocument, MatchAllDocuments and GetWordFrequencies
+    // dangle afterwards; LoadSnapshot does the same
+    void Compact();
+
+    // off by default, as it makes removal invalidate returned words the way Compact does
+    void SetAutoCompaction(bool is_enabled);
+
+    bool GetAutoCompaction() const;
+
+    // owned memory, a mapped snapshot is not counted; node containers are estimated
+    std::size_t GetMemoryUsage() const;
+
+    void SaveSnapshot(const std::string &path) const;
+
+    // replaces the whole index, stop words included, with the snapshot contents;
+    // the index is served from the mapped file and copied piecewise on the first change
+    void LoadSnapshot(const std::string &path);
+
 private:
+    using TermId = TermDictionary::TermId;
+
+    // dense internal id assigned in insertion order, never reused
+    using DocumentIndex = std::uint32_t;
+
+    // no padding inside, so the snapshot stores it byte for byte
     struct DocumentData
     {
+        int id;
         int rating;
         DocumentStatus status;
+        // terms of the document are document_terms_[terms_begin, terms_begin + term_count)
+        std::uint32_t term_count;
+        std::uint64_t terms_begin;
+        // postings keep term counts, term_freq = term_count * inv_word_count
+        double inv_word_count;
     };
 
-    const std::set<std::string, std::less<>> stop_words_;
+    static_assert(sizeof(DocumentData) == 32, "DocumentData must not have padding");
 
-    std::set<std::string> words_;
+    struct DocumentTerm
+    {
+        TermId term;
+        std::uint32_t term_count;
+    };
 
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
+    struct SnapshotMeta
+    {
+        TermId stop_term_count;
+        std::uint32_t reserved;
+    };
 
-    std::map<int, DocumentData> documents_;
+    struct SnapshotDocumentId
+    {
+        int id;
+        DocumentIndex document_index;
+    };
+
+    TermDictionary dictionary_;
+
+    TermId stop_term_count_ = 0;
+
+    // sealed segments in document order; a merge only reads them, so they are shared with it
+    std::vector<std::shared_ptr<const IndexSegment>> segments_;
+
+    // takes new documents, starts where the last sealed segment ends
+    IndexSegment active_segment_{0};
+
+    // documents per term over all segments, IDF is global however the index is split
+    std::vector<std::uint32_t> term_document_freqs_;
+
+    // upper bound of term_freq over the term's postings, kept loose on removal
+    MappedArray<double> term_max_freqs_;
+
+    std::vector<double> term_log_document_freqs_;
+
+    double log_document_count_ = 0.0;
+
+    QueryEvaluation query_evaluation_ = QueryEvaluation::MAX_SCORE;
+
+    bool is_auto_compaction_enabled_ = false;
+
+    MappedArray<DocumentData> documents_;
+
+    // forward index, the terms of each document sorted by id; removed documents leave their range unused
+    MappedArray<DocumentTerm> document_terms_;
+
+    // tombstones by document index, sized on the first removal; postings of a removed
+    // document stay in its segment until Compact
+    std::vector<bool> removed_documents_;
+
+    std::unordered_map<int, DocumentIndex> id_to_document_index_;
 
     std::set<int> document_ids_;
 
-    std::map<int, std::map<std::string_view, double>> id_to_word_freqs_;
+    // keeps the mapping alive while any of the arrays above refers to it
+    std::shared_ptr<const MappedFile> snapshot_file_;
+
+    // bumped by every change of the index, cached results of older generations are not served
+    std::uint64_t index_generation_ = 0;
 
-    bool IsStopWord(std::string_view word) const;
+    std::unique_ptr<QueryResultCache> query_cache_;
+
+    std::shared_ptr<ThreadPool> executor_;
+
+    std::size_t min_range_document_count_ = MIN_PARALLEL_RANGE_DOCUMENT_COUNT;
+
+    // merge of segments_[merge_first_segment_, merge_first_segment_ + SEGMENT_MERGE_FACTOR) running in
+    // the background; declared after snapshot_file_ so destruction waits for it before unmapping
+    std::future<IndexSegment> merge_;
+    std::size_t merge_first_segment_ = 0;
+
+    bool IsStopTerm(TermId term) const;
 
     static bool IsValidWord(std::string_view word);
 
-    std::vector<std::string_view> SplitIntoWordsViewNoStop(std::string_view text) const;
+    std::vector<TermId> InternWordsNoStop(std::string_view text);
+
+    void AddDocumentBatch(const std::vector<const NewDocument *> &batch, bool is_parallel);
 
     static int ComputeAverageRating(const std::vector<int> &ratings);
 
+    DocumentIndex GetDocumentIndex(int document_id) const;
+
+    const IndexSegment &FindSegment(DocumentIndex document_index) const;
+
+    bool IsRemoved(DocumentIndex document_index) const
+    {
+        return document_index < removed_documents_.size() && removed_documents_[document_index];
+    }
+
+    // shared by both RemoveDocument overloads once the document's terms are dealt with
+    // tombstones the document, the caller has updated the term frequencies
+    void MarkRemoved(DocumentIndex document_index);
+
+    // updates the document count after removals and, if enabled, compacts the index when most of it is removed
+    void FinishRemoval();
+
+    TermPostings GetTermPostings(TermId term) const;
+
+    bool ContainsTerm(TermId term, DocumentIndex document_index) const;
+
+    void SealActiveSegment();
+
+    static std::size_t GetSegmentTier(const IndexSegment &segment);
+
+    // installs a finished merge and starts the next one the policy asks for
+    void ScheduleMerge();
+
+    // waits for the running merge, if any, and installs it
+    void FinishMerge();
+
+
     struct QueryWord
     {
-        std::string_view data;
+        TermId term;
         bool is_minus;
         bool is_stop;
     };
 
-    QueryWord ParseQueryWord(std::string_view text) const;
+    // is_valid tells whether the tokenizer found no control characters in the word;
+    // returns the word without its minus, throws on an invalid one
+    static std::string_view CheckQueryWord(std::string_view text, bool is_valid, bool &is_minus);
+
+    QueryWord ParseQueryWord(std::string_view text, bool is_valid) const;
 
     struct Query
     {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        std::vector<TermId> plus_terms;
+        std::vector<TermId> minus_terms;
+        // by plus term when scored with corpus statistics, empty when the index's own are used
+        std::vector<double> inverse_document_freqs;
     };
 
-    void SortUnique(std::vector<std::string_view> &vector) const;
+    void SortUnique(std::vector<TermId> &vector) const;
 
     Query ParseQuery(std::string_view text, bool sort_request) const;
 
-    double ComputeWordInverseDocumentFreq(std::string_view word) const;
+    // the sorted, unique terms of the query with everything else that changes its results
+    static std::string MakeQueryCacheKey(const Query &query, DocumentStatus status, std::size_t max_count);
+
+    // log(N / df) as log(N) - log(df), both logs kept up to date by AddDocument and RemoveDocument
+    double ComputeTermInverseDocumentFreq(TermId term) const
+    {
+        return log_document_count_ - term_log_document_freqs_[term];
+    }
+
+    double GetInverseDocumentFreq(const Query &query, std::size_t position) const
+    {
+        return query.inverse_document_freqs.empty() ? ComputeTermInverseDocumentFreq(query.plus_terms[position])
+                                                    : query.inverse_document_freqs[position];
+    }
+
+    // fills the words and terms of a profile, the query is parsed from raw_query
+    void DescribeQuery(std::string_view raw_query, const Query &query, QueryProfile &profile) const;
+
+    // plus terms ordered by rank, with inverse document frequencies from the statistics
+    Query ParseQuery(const QueryWords &query_words, const CorpusStatistics &statistics) const;
+
+    // ranges the document index space is cut into for a parallel pass
+    std::size_t GetParallelRangeCount() const;
+
+    // calls function(range) for every range in [0, range_count), on the executor or std::execution::par
+    template <typename Function>
+    void ForEachRange(std::size_t range_count, Function function) const;
+
+    void UpdateTermLogDocumentFreq(TermId term);
+
+    void UpdateLogDocumentCount();
+
+    template <typename DocumentPredicate>
+    void FindAllDocuments(const std::execution::sequenced_policy &, Query &query,
+                          DocumentPredicate document_predicate, TopDocumentsCollector &top_documents) const;
 
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy &, Query &query,
-                                           DocumentPredicate document_predicate) const;
+    void FindTopDocumentsMaxScore(const Query &query, DocumentPredicate document_predicate,
+                                  TopDocumentsCollector &top_documents) const;
 
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(Query &query,
-                                           DocumentPredicate document_predicate) const;
+    void FindAllDocuments(Query &query,
+                          DocumentPredicate document_predicate, TopDocumentsCollector &top_documents) const;
 
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy &, Query &query,
-                                           DocumentPredicate document_predicate) const;
+    void FindAllDocuments(const std::execution::parallel_policy &, Query &query,
+                          DocumentPredicate document_predicate, TopDocumentsCollector &top_documents) const;
+};
+
+// (word, term frequency) pairs of a document without stop words, in term id order rather than
+// by word. The view is valid until the server is changed, words taken from it until Compact or LoadSnapshot
+class SearchServer::WordFrequencies
+{
+public:
+    class Iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<std::string_view, double>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        Iterator() = default;
+
+        Iterator(const TermDictionary *dictionary, const DocumentTerm *term, double inv_word_count)
+            : dictionary_(dictionary), term_(term), inv_word_count_(inv_word_count)
+        {
+        }
+
+        value_type operator*() const
+        {
+            return {dictionary_->GetWord(term_->term), term_->term_count * inv_word_count_};
+        }
+
+        Iterator &operator++()
+        {
+            ++term_;
+            return *this;
+        }
+
+        Iterator operator++(int)
+        {
+            Iterator old = *this;
+            ++term_;
+            return old;
+        }
+
+        bool operator==(const Iterator &other) const
+        {
+            return term_ == other.term_;
+        }
+
+        bool operator!=(const Iterator &other) const
+        {
+            return term_ != other.term_;
+        }
+
+    private:
+        const TermDictionary *dictionary_ = nullptr;
+        const DocumentTerm *term_ = nullptr;
+        double inv_word_count_ = 0.0;
+    };
+
+    WordFrequencies() = default;
+
+    WordFrequencies(const TermDictionary &dictionary, const DocumentTerm *terms, std::size_t size, double inv_word_count)
+        : dictionary_(&dictionary), terms_(terms), size_(size), inv_word_count_(inv_word_count)
+    {
+    }
+
+    Iterator begin() const
+    {
+        return {dictionary_, terms_, inv_word_count_};
+    }
+
+    Iterator end() const
+    {
+        return {dictionary_, terms_ + size_, inv_word_count_};
+    }
+
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+
+private:
+    const TermDictionary *dictionary_ = nullptr;
+    const DocumentTerm *terms_ = nullptr;
+    std::size_t size_ = 0;
+    double inv_word_count_ = 0.0;
 };
 
 template <typename StringContainer>
 SearchServer::SearchServer(StringContainer stop_words)
-    : stop_words_(MakeUniqueNonEmptyStrings(stop_words))
 {
-    if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord))
+    const auto unique_stop_words = MakeUniqueNonEmptyStrings(stop_words);
+    if (!all_of(unique_stop_words.begin(), unique_stop_words.end(), IsValidWord))
     {
         throw std::invalid_argument("Some of stop words are invalid");
     }
+    // stop words take the first term ids, so IsStopTerm is a single comparison
+    for (const std::string &word : unique_stop_words)
+    {
+        dictionary_.Intern(word);
+    }
+    stop_term_count_ = static_cast<TermId>(dictionary_.GetSize());
+}
+
+template <typename ExecutionPolicy, typename DocumentRange>
+void SearchServer::AddDocuments(const ExecutionPolicy &policy, const DocumentRange &documents)
+{
+    std::vector<const NewDocument *> batch;
+    for (const NewDocument &document : documents)
+    {
+        batch.push_back(&document);
+    }
+    AddDocumentBatch(batch, !std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>);
+}
+
+template <typename DocumentRange>
+void SearchServer::AddDocuments(const DocumentRange &documents)
+{
+    AddDocuments(std::execution::seq, documents);
 }
 
 template <typename ExecutionPolicy, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy &policy, std::string_view raw_query,
-                                                     DocumentPredicate document_predicate) const
+                                                     DocumentPredicate document_predicate, std::size_t max_count) const
 {
     bool sort_request = true;
     if (std::is_same_v<ExecutionPolicy, std::execution::parallel_policy>)
@@ -163,30 +622,46 @@ std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy &poli
 
     if (!sort_request)
     {
-        SortUnique(query.minus_words);
-        SortUnique(query.plus_words);
+        SortUnique(query.minus_terms);
+        SortUnique(query.plus_terms);
     }
 
-    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
-
-    std::sort(policy, matched_documents.begin(), matched_documents.end(),
-              [](const Document &lhs, const Document &rhs)
-              {
-                  return lhs.relevance > rhs.relevance || (std::abs(lhs.relevance - rhs.relevance) < EPSILON && lhs.rating > rhs.rating);
-              });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT)
-    {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
-    return matched_documents;
+    AddMetricCounter(MetricCounter::QUERIES, 1);
+    TopDocumentsCollector top_documents(max_count);
+    FindAllDocuments(policy, query, document_predicate, top_documents);
+    QueryStageTimer sorting_timer(QueryStage::SORTING);
+    return top_documents.Extract();
 }
 
 template <typename ExecutionPolicy>
-std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy &policy, std::string_view raw_query, DocumentStatus status) const
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy &policy, std::string_view raw_query, DocumentStatus status,
+                                                     std::size_t max_count) const
 {
-    return FindTopDocuments(
-        policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating)
-        { return document_status == status; });
+    const auto status_predicate = [status](int document_id, DocumentStatus document_status, int rating)
+    { return document_status == status; };
+    if (!query_cache_)
+    {
+        return FindTopDocuments(policy, raw_query, status_predicate, max_count);
+    }
+
+    // the same query written with other word order or repeats shares one entry
+    AddMetricCounter(MetricCounter::QUERIES, 1);
+    auto query = ParseQuery(raw_query, true);
+    const std::string key = MakeQueryCacheKey(query, status, max_count);
+    QueryStageTimer lookup_timer(QueryStage::MATERIALIZATION);
+    if (auto documents = query_cache_->Find(key, index_generation_))
+    {
+        return std::move(*documents);
+    }
+    lookup_timer.Stop();
+    TopDocumentsCollector top_documents(max_count);
+    FindAllDocuments(policy, query, status_predicate, top_documents);
+    QueryStageTimer sorting_timer(QueryStage::SORTING);
+    auto documents = top_documents.Extract();
+    sorting_timer.Stop();
+    QueryStageTimer insert_timer(QueryStage::MATERIALIZATION);
+    query_cache_->Insert(key, index_generation_, documents);
+    return documents;
 }
 
 template <typename ExecutionPolicy>
@@ -197,105 +672,522 @@ std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy &poli
 
 template <typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query,
-                                                     DocumentPredicate document_predicate) const
+                                                     DocumentPredicate document_predicate, std::size_t max_count) const
 {
-    return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+    return FindTopDocuments(std::execution::seq, raw_query, document_predicate, max_count);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocumentsWithStatistics(const ExecutionPolicy &policy, const QueryWords &query_words,
+                                                                   const CorpusStatistics &statistics, DocumentPredicate document_predicate,
+                                                                   std::size_t max_count) const
+{
+    auto query = ParseQuery(query_words, statistics);
+    AddMetricCounter(MetricCounter::QUERIES, 1);
+    TopDocumentsCollector top_documents(max_count);
+    FindAllDocuments(policy, query, document_predicate, top_documents);
+    QueryStageTimer sorting_timer(QueryStage::SORTING);
+    return top_documents.Extract();
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy &, Query &query,
-                                                     DocumentPredicate document_predicate) const
+ExplainedDocuments SearchServer::FindTopDocumentsExplained(std::string_view raw_query, DocumentPredicate document_predicate,
+                                                           std::size_t max_count) const
 {
-    std::map<int, double> document_to_relevance;
-    for (std::string_view word : query.plus_words)
+    using Clock = std::chrono::steady_clock;
+    ExplainedDocuments result;
+    QueryProfile &profile = result.profile;
+    auto stage_start = Clock::now();
+    const auto finish_stage = [&profile, &stage_start](QueryStage stage)
+    {
+        const auto now = Clock::now();
+        profile.stage_durations[static_cast<std::size_t>(stage)] = now - stage_start;
+        stage_start = now;
+    };
+
+    const Query query = ParseQuery(raw_query, true);
+    finish_stage(QueryStage::PARSE);
+    DescribeQuery(raw_query, query, profile);
+
+    // the exhaustive engine with the predicate applied after minus words, so each step can be
+    // counted; relevance is summed in the same order, so it is the same bit for bit
+    stage_start = Clock::now();
+    std::vector<double> document_to_relevance(documents_.size(), -1.0);
+    for (std::size_t position = 0; position < query.plus_terms.size(); ++position)
     {
-        if (word_to_document_freqs_.count(word) == 0)
+        const TermPostings postings = GetTermPostings(query.plus_terms[position]);
+        if (postings.empty())
         {
             continue;
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word))
+        const double inverse_document_freq = GetInverseDocumentFreq(query, position);
+        postings.ForEach([&](DocumentIndex document_index, std::uint32_t term_count)
+                         {
+                             if (IsRemoved(document_index))
+                             {
+                                 return;
+                             }
+                             double &relevance = document_to_relevance[document_index];
+                             if (relevance < 0.0)
+                             {
+                                 ++profile.documents_scored;
+                             }
+                             relevance = std::max(relevance, 0.0) + term_count * documents_[document_index].inv_word_count * inverse_document_freq; });
+    }
+    finish_stage(QueryStage::POSTING_TRAVERSAL);
+
+    for (const TermId term : query.minus_terms)
+    {
+        GetTermPostings(term).ForEach([&](DocumentIndex document_index, std::uint32_t)
+                                      {
+                                          double &relevance = document_to_relevance[document_index];
+                                          if (relevance >= 0.0)
+                                          {
+                                              relevance = -1.0;
+                                              ++profile.documents_eliminated;
+                                          } });
+    }
+    finish_stage(QueryStage::MINUS_WORDS);
+
+    TopDocumentsCollector top_documents(max_count);
+    for (DocumentIndex document_index = 0; document_index < document_to_relevance.size(); ++document_index)
+    {
+        const double relevance = document_to_relevance[document_index];
+        if (relevance < 0.0)
         {
-            const auto &document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating))
-            {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
-            }
+            continue;
+        }
+        const auto &document_data = documents_[document_index];
+        if (document_predicate(document_data.id, document_data.status, document_data.rating))
+        {
+            top_documents.Add({document_data.id, relevance, document_data.rating});
+        }
+        else
+        {
+            ++profile.documents_filtered;
         }
     }
-    for (std::string_view word : query.minus_words)
+    finish_stage(QueryStage::FILTERING);
+
+    result.documents = top_documents.Extract();
+    finish_stage(QueryStage::SORTING);
+    return result;
+}
+
+template <typename DocumentPredicate>
+void SearchServer::FindAllDocuments(const std::execution::sequenced_policy &, Query &query,
+                                    DocumentPredicate document_predicate, TopDocumentsCollector &top_documents) const
+{
+    if (query_evaluation_ == QueryEvaluation::MAX_SCORE)
     {
-        if (word_to_document_freqs_.count(word) == 0)
+        FindTopDocumentsMaxScore(query, document_predicate, top_documents);
+        return;
+    }
+    QueryStageTimer traversal_timer(QueryStage::POSTING_TRAVERSAL);
+    std::size_t postings_scanned = 0;
+    // relevance is never negative, so a negative value marks a document nothing matched
+    std::vector<double> document_to_relevance(documents_.size(), -1.0);
+    for (std::size_t position = 0; position < query.plus_terms.size(); ++position)
+    {
+        const TermPostings postings = GetTermPostings(query.plus_terms[position]);
+        if (postings.empty())
         {
             continue;
         }
-        for (auto [document_id, _] : word_to_document_freqs_.at(word))
+        postings_scanned += postings.size();
+        const double inverse_document_freq = GetInverseDocumentFreq(query, position);
+        postings.ForEach([&](DocumentIndex document_index, std::uint32_t term_count)
+                         {
+                             const auto &document_data = documents_[document_index];
+                             if (!IsRemoved(document_index) && document_predicate(document_data.id, document_data.status, document_data.rating))
+                             {
+                                 double &relevance = document_to_relevance[document_index];
+                                 relevance = std::max(relevance, 0.0) + term_count * document_data.inv_word_count * inverse_document_freq;
+                             } });
+    }
+    traversal_timer.Stop();
+
+    QueryStageTimer minus_words_timer(QueryStage::MINUS_WORDS);
+    for (const TermId term : query.minus_terms)
+    {
+        const TermPostings postings = GetTermPostings(term);
+        postings_scanned += postings.size();
+        postings.ForEach([&document_to_relevance](DocumentIndex document_index, std::uint32_t)
+                         { document_to_relevance[document_index] = -1.0; });
+    }
+    minus_words_timer.Stop();
+
+    QueryStageTimer filtering_timer(QueryStage::FILTERING);
+    std::size_t documents_scored = 0;
+    for (DocumentIndex document_index = 0; document_index < document_to_relevance.size(); ++document_index)
+    {
+        const double relevance = document_to_relevance[document_index];
+        if (relevance >= 0.0)
+        {
+            const auto &document_data = documents_[document_index];
+            top_documents.Add({document_data.id, relevance, document_data.rating});
+            ++documents_scored;
+        }
+    }
+    AddMetricCounter(MetricCounter::POSTINGS_SCANNED, postings_scanned);
+    AddMetricCounter(MetricCounter::DOCUMENTS_SCORED, documents_scored);
+}
+
+template <typename DocumentPredicate>
+void SearchServer::FindTopDocumentsMaxScore(const Query &query, DocumentPredicate document_predicate,
+                                            TopDocumentsCollector &top_documents) const
+{
+    // document-at-a-time MaxScore: lists are ordered by score upper bound and the
+    // cheapest prefix whose bounds cannot lift a document into the top is only probed
+    QueryStageTimer traversal_timer(QueryStage::POSTING_TRAVERSAL);
+    struct Cursor
+    {
+        TermPostings::Cursor postings;
+        double inverse_document_freq;
+        double max_score;
+        std::size_t query_position;
+    };
+
+    // cursors point into the postings, so neither vector grows after reserve
+    std::vector<TermPostings> plus_postings;
+    plus_postings.reserve(query.plus_terms.size());
+    std::vector<Cursor> cursors;
+    cursors.reserve(query.plus_terms.size());
+    for (std::size_t position = 0; position < query.plus_terms.size(); ++position)
+    {
+        const TermId term = query.plus_terms[position];
+        const TermPostings &postings = plus_postings.emplace_back(GetTermPostings(term));
+        if (postings.empty())
         {
-            document_to_relevance.erase(document_id);
+            continue;
         }
+        const double inverse_document_freq = GetInverseDocumentFreq(query, position);
+        cursors.push_back({postings.GetCursor(), inverse_document_freq,
+                           term_max_freqs_[term] * inverse_document_freq, position});
+    }
+    std::sort(cursors.begin(), cursors.end(), [](const Cursor &lhs, const Cursor &rhs)
+              { return lhs.max_score < rhs.max_score; });
+    std::vector<double> prefix_max_scores(cursors.size());
+    double max_score_sum = 0.0;
+    for (std::size_t i = 0; i < cursors.size(); ++i)
+    {
+        max_score_sum += cursors[i].max_score;
+        prefix_max_scores[i] = max_score_sum;
     }
 
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance)
+    std::vector<TermPostings> minus_postings;
+    minus_postings.reserve(query.minus_terms.size());
+    std::vector<TermPostings::Cursor> minus_cursors;
+    for (const TermId term : query.minus_terms)
     {
-        matched_documents.push_back(
-            {document_id, relevance, documents_.at(document_id).rating});
+        minus_cursors.push_back(minus_postings.emplace_back(GetTermPostings(term)).GetCursor());
     }
-    return matched_documents;
+
+    // scores are summed in query order, exactly as the exhaustive path does
+    std::vector<double> contributions(query.plus_terms.size());
+    std::vector<bool> has_contribution(query.plus_terms.size());
+    std::size_t first_essential = 0;
+    // postings read here are the ones a candidate was found in, skipped ones are not counted
+    std::size_t postings_scanned = 0;
+    std::size_t documents_scored = 0;
+    while (true)
+    {
+        // a document has to come within EPSILON of the current minimum to win a tie on rating
+        const double threshold = top_documents.IsFull() ? top_documents.GetLeastRelevant().relevance - EPSILON
+                                                        : -std::numeric_limits<double>::infinity();
+        while (first_essential < cursors.size() && prefix_max_scores[first_essential] < threshold)
+        {
+            ++first_essential;
+        }
+        if (first_essential == cursors.size())
+        {
+            break;
+        }
+
+        DocumentIndex candidate = std::numeric_limits<DocumentIndex>::max();
+        for (std::size_t i = first_essential; i < cursors.size(); ++i)
+        {
+            if (!cursors[i].postings.IsEnd())
+            {
+                candidate = std::min(candidate, cursors[i].postings.GetDocumentIndex());
+            }
+        }
+        if (candidate == std::numeric_limits<DocumentIndex>::max())
+        {
+            break;
+        }
+
+        const auto &document_data = documents_[candidate];
+        std::fill(has_contribution.begin(), has_contribution.end(), false);
+        double score = 0.0;
+        ++documents_scored;
+        for (std::size_t i = first_essential; i < cursors.size(); ++i)
+        {
+            Cursor &cursor = cursors[i];
+            if (!cursor.postings.IsEnd() && cursor.postings.GetDocumentIndex() == candidate)
+            {
+                contributions[cursor.query_position] = cursor.postings.GetTermCount() * document_data.inv_word_count * cursor.inverse_document_freq;
+                has_contribution[cursor.query_position] = true;
+                score += contributions[cursor.query_position];
+                cursor.postings.Next();
+                ++postings_scanned;
+            }
+        }
+        if (IsRemoved(candidate))
+        {
+            continue;
+        }
+        bool is_pruned = false;
+        for (std::size_t i = first_essential; i-- > 0;)
+        {
+            if (score + prefix_max_scores[i] < threshold)
+            {
+                is_pruned = true;
+                break;
+            }
+            Cursor &cursor = cursors[i];
+            if (cursor.postings.Seek(candidate))
+            {
+                contributions[cursor.query_position] = cursor.postings.GetTermCount() * document_data.inv_word_count * cursor.inverse_document_freq;
+                has_contribution[cursor.query_position] = true;
+                score += contributions[cursor.query_position];
+                ++postings_scanned;
+            }
+        }
+        if (is_pruned)
+        {
+            continue;
+        }
+        if (std::any_of(minus_cursors.begin(), minus_cursors.end(), [candidate](TermPostings::Cursor &cursor)
+                        { return cursor.Seek(candidate); }))
+        {
+            continue;
+        }
+        if (!document_predicate(document_data.id, document_data.status, document_data.rating))
+        {
+            continue;
+        }
+        double relevance = 0.0;
+        for (std::size_t position = 0; position < contributions.size(); ++position)
+        {
+            if (has_contribution[position])
+            {
+                relevance += contributions[position];
+            }
+        }
+        top_documents.Add({document_data.id, relevance, document_data.rating});
+    }
+    AddMetricCounter(MetricCounter::POSTINGS_SCANNED, postings_scanned);
+    AddMetricCounter(MetricCounter::DOCUMENTS_SCORED, documents_scored);
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(Query &query,
-                                                     DocumentPredicate document_predicate) const
+void SearchServer::FindAllDocuments(Query &query,
+                                    DocumentPredicate document_predicate, TopDocumentsCollector &top_documents) const
 {
-    return SearchServer::FindAllDocuments(std::execution::seq, query, document_predicate);
+    SearchServer::FindAllDocuments(std::execution::seq, query, document_predicate, top_documents);
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy &, Query &query,
-                                                     DocumentPredicate document_predicate) const
+void SearchServer::FindAllDocuments(const std::execution::parallel_policy &, Query &query,
+                                    DocumentPredicate document_predicate, TopDocumentsCollector &top_documents) const
 {
-    ConcurrentMap<int, double> pre_document_to_relevance(BUCKETS_COUNT);
-
-    std::for_each(std::execution::par,
-                  query.plus_words.begin(),
-                  query.plus_words.end(),
-                  [this, &pre_document_to_relevance, document_predicate](const std::string_view &word)
-                  {
-                      if (word_to_document_freqs_.count(word) == 0)
-                          return;
-
-                      const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-
-                      for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word))
-                      {
-                          const auto &document_data = documents_.at(document_id);
-                          if (document_predicate(document_id, document_data.status, document_data.rating))
-                          {
-                              pre_document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-                          }
-                      }
-                  });
-
-    std::for_each(std::execution::par,
-                  query.minus_words.begin(),
-                  query.minus_words.end(),
-                  [this, &pre_document_to_relevance](const std::string_view &word)
-                  {
-                      if (word_to_document_freqs_.count(word) == 0)
-                          return;
-                      for (const auto [document_id, _] : word_to_document_freqs_.at(word))
-                      {
-                          pre_document_to_relevance.erase(document_id);
-                      }
-                  });
-
-    auto document_to_relevance = pre_document_to_relevance.BuildOrdinaryMap();
-
-    std::vector<Document> matched_documents(document_to_relevance.size());
-    std::transform(std::execution::par, document_to_relevance.begin(), document_to_relevance.end(), matched_documents.begin(), [this](const auto &map)
-                   { return Document{map.first, map.second, documents_.at(map.first).rating}; });
-    return matched_documents;
+    // the document index space is cut into ranges scored independently: a range seeks every
+    // posting list to its start and keeps its own accumulator and heap, so no locks are needed
+    const std::size_t document_count = documents_.size();
+    const std::size_t range_count = GetParallelRangeCount();
+    std::vector<TermPostings> plus_postings;
+    std::vector<double> inverse_document_freqs(query.plus_terms.size());
+    for (std::size_t i = 0; i < query.plus_terms.size(); ++i)
+    {
+        if (!plus_postings.emplace_back(GetTermPostings(query.plus_terms[i])).empty())
+        {
+            inverse_document_freqs[i] = GetInverseDocumentFreq(query, i);
+        }
+    }
+    std::vector<TermPostings> minus_postings;
+    for (const TermId term : query.minus_terms)
+    {
+        minus_postings.push_back(GetTermPostings(term));
+    }
+    std::vector<TopDocumentsCollector> range_top_documents(range_count, TopDocumentsCollector(top_documents.GetMaxCount()));
+    const auto score_range = [&](std::size_t range)
+    {
+        const auto first = static_cast<DocumentIndex>(document_count * range / range_count);
+        const auto last = static_cast<DocumentIndex>(document_count * (range + 1) / range_count);
+        // stages are timed per range, on the thread that scores it
+        QueryStageTimer traversal_timer(QueryStage::POSTING_TRAVERSAL);
+        std::size_t postings_scanned = 0;
+        // relevance is never negative, so a negative value marks a document nothing matched
+        std::vector<double> document_to_relevance(last - first, -1.0);
+        const auto for_each_posting = [&](const TermPostings &postings, const auto &function)
+        {
+            if (postings.empty() || postings.GetLastDocumentIndex() < first)
+            {
+                return;
+            }
+            TermPostings::Cursor cursor = postings.GetCursor();
+            cursor.Seek(first);
+            for (; !cursor.IsEnd() && cursor.GetDocumentIndex() < last; cursor.Next())
+            {
+                function(cursor.GetDocumentIndex(), cursor.GetTermCount());
+                ++postings_scanned;
+            }
+        };
+        for (std::size_t i = 0; i < query.plus_terms.size(); ++i)
+        {
+            const double inverse_document_freq = inverse_document_freqs[i];
+            for_each_posting(plus_postings[i], [&](DocumentIndex document_index, std::uint32_t term_count)
+                             {
+                                 double &relevance = document_to_relevance[document_index - first];
+                                 relevance = std::max(relevance, 0.0) + term_count * documents_[document_index].inv_word_count * inverse_document_freq; });
+        }
+        traversal_timer.Stop();
+        QueryStageTimer minus_words_timer(QueryStage::MINUS_WORDS);
+        for (const TermPostings &postings : minus_postings)
+        {
+            for_each_posting(postings, [&](DocumentIndex document_index, std::uint32_t)
+                             { document_to_relevance[document_index - first] = -1.0; });
+        }
+        minus_words_timer.Stop();
+        QueryStageTimer filtering_timer(QueryStage::FILTERING);
+        std::size_t documents_scored = 0;
+        for (DocumentIndex document_index = first; document_index < last; ++document_index)
+        {
+            const double relevance = document_to_relevance[document_index - first];
+            const auto &document_data = documents_[document_index];
+            if (relevance >= 0.0 && !IsRemoved(document_index) && document_predicate(document_data.id, document_data.status, document_data.rating))
+            {
+                range_top_documents[range].Add({document_data.id, relevance, document_data.rating});
+                ++documents_scored;
+            }
+        }
+        AddMetricCounter(MetricCounter::POSTINGS_SCANNED, postings_scanned);
+        AddMetricCounter(MetricCounter::DOCUMENTS_SCORED, documents_scored);
+    };
+    ForEachRange(range_count, score_range);
+    for (const auto &range_top : range_top_documents)
+    {
+        top_documents.Merge(range_top);
+    }
+}
+
+template <typename Function>
+void SearchServer::ForEachRange(std::size_t range_count, Function function) const
+{
+    if (executor_)
+    {
+        executor_->ParallelFor(range_count, 1, [&function](std::size_t begin, std::size_t end)
+                               {
+                                   for (std::size_t range = begin; range < end; ++range)
+                                   {
+                                       function(range);
+                                   } });
+    }
+    else
+    {
+        std::vector<std::size_t> ranges(range_count);
+        std::iota(ranges.begin(), ranges.end(), 0);
+        std::for_each(std::execution::par, ranges.begin(), ranges.end(), function);
+    }
+}
+
+template <typename ExecutionPolicy, typename MatchSink>
+void SearchServer::MatchAllDocuments(const ExecutionPolicy &, std::string_view raw_query, MatchSink sink) const
+{
+    if (!IsValidWord(raw_query))
+    {
+        throw std::invalid_argument("Invalid query");
+    }
+    auto query = ParseQuery(raw_query, true);
+    // plus terms in word order, so the words of every document come out sorted
+    std::sort(query.plus_terms.begin(), query.plus_terms.end(), [this](TermId lhs, TermId rhs)
+              { return dictionary_.GetWord(lhs) < dictionary_.GetWord(rhs); });
+    std::vector<std::string_view> plus_words;
+    std::vector<TermPostings> plus_postings;
+    for (const TermId term : query.plus_terms)
+    {
+        plus_words.push_back(dictionary_.GetWord(term));
+        plus_postings.push_back(GetTermPostings(term));
+    }
+    std::vector<TermPostings> minus_postings;
+    for (const TermId term : query.minus_terms)
+    {
+        minus_postings.push_back(GetTermPostings(term));
+    }
+
+    constexpr bool is_parallel = std::is_same_v<ExecutionPolicy, std::execution::parallel_policy>;
+    const std::size_t document_count = documents_.size();
+    const std::size_t range_count = is_parallel ? GetParallelRangeCount() : 1;
+    const auto match_range = [&](std::size_t range)
+    {
+        const auto first = static_cast<DocumentIndex>(document_count * range / range_count);
+        const auto last = static_cast<DocumentIndex>(document_count * (range + 1) / range_count);
+        const auto get_cursors = [first](const std::vector<TermPostings> &postings)
+        {
+            std::vector<TermPostings::Cursor> cursors;
+            for (const TermPostings &term_postings : postings)
+            {
+                cursors.push_back(term_postings.GetCursor());
+                cursors.back().Seek(first);
+            }
+            return cursors;
+        };
+        std::vector<TermPostings::Cursor> plus_cursors = get_cursors(plus_postings);
+        std::vector<TermPostings::Cursor> minus_cursors = get_cursors(minus_postings);
+        // a cursor standing on the document is moved past it, so each list is read once
+        const auto take = [](TermPostings::Cursor &cursor, DocumentIndex document_index)
+        {
+            if (cursor.IsEnd() || cursor.GetDocumentIndex() != document_index)
+            {
+                return false;
+            }
+            cursor.Next();
+            return true;
+        };
+        std::vector<std::string_view> words;
+        words.reserve(plus_words.size());
+        for (DocumentIndex document_index = first; document_index < last; ++document_index)
+        {
+            words.clear();
+            for (std::size_t i = 0; i < plus_cursors.size(); ++i)
+            {
+                if (take(plus_cursors[i], document_index))
+                {
+                    words.push_back(plus_words[i]);
+                }
+            }
+            bool has_minus_word = false;
+            for (TermPostings::Cursor &cursor : minus_cursors)
+            {
+                has_minus_word = take(cursor, document_index) || has_minus_word;
+            }
+            if (IsRemoved(document_index))
+            {
+                continue;
+            }
+            // an entry its id no longer points to is stale, a live id is reported once
+            const DocumentData &document_data = documents_[document_index];
+            const auto it = id_to_document_index_.find(document_data.id);
+            if (it == id_to_document_index_.end() || it->second != document_index)
+            {
+                continue;
+            }
+            if (has_minus_word)
+            {
+                words.clear();
+            }
+            sink(document_data.id, std::as_const(words), document_data.status);
+        }
+    };
+    if constexpr (is_parallel)
+    {
+        ForEachRange(range_count, match_range);
+    }
+    else
+    {
+        match_range(0);
+    }
 }
 
 void AddDocument(SearchServer &search_server, int document_id, std::string_view document,
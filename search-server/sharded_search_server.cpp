@@ -0,0 +1,85 @@
+#include "sharded_search_server.h"
+
+using namespace std;
+
+ShardedSearchServer::ShardedSearchServer(size_t shard_count, string_view stop_words_text)
+    : ShardedSearchServer(shard_count, SplitIntoWordsView(stop_words_text))
+{
+}
+
+ShardedSearchServer::ShardedSearchServer(size_t shard_count, const string &stop_words_text)
+    : ShardedSearchServer(shard_count, string_view(stop_words_text))
+{
+}
+
+void ShardedSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status,
+                                      const vector<int> &ratings)
+{
+    if (document_id < 0)
+    {
+        throw invalid_argument("Invalid document_id"s);
+    }
+    shards_[GetShardIndex(document_id)]->AddDocument(document_id, document, status, ratings);
+    // only once the shard took the document, a rejected one must not take a rank
+    for (const string_view word : SplitIntoWordsView(document))
+    {
+        dictionary_.Intern(word);
+    }
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id)
+{
+    shards_[GetShardIndex(document_id)]->RemoveDocument(document_id);
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status,
+                                                       size_t max_count) const
+{
+    return FindTopDocuments(execution::seq, raw_query, status, max_count);
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(string_view raw_query) const
+{
+    return FindTopDocuments(execution::seq, raw_query);
+}
+
+SearchServer::MatchTuple ShardedSearchServer::MatchDocument(string_view raw_query, int document_id) const
+{
+    return shards_[GetShardIndex(document_id)]->MatchDocument(raw_query, document_id);
+}
+
+SearchServer::WordFrequencies ShardedSearchServer::GetWordFrequencies(int document_id) const
+{
+    return shards_[GetShardIndex(document_id)]->GetWordFrequencies(document_id);
+}
+
+int ShardedSearchServer::GetDocumentCount() const
+{
+    int document_count = 0;
+    for (const auto &shard : shards_)
+    {
+        document_count += shard->GetDocumentCount();
+    }
+    return document_count;
+}
+
+size_t ShardedSearchServer::GetShardCount() const
+{
+    return shards_.size();
+}
+
+const SearchServer &ShardedSearchServer::GetShard(size_t index) const
+{
+    return *shards_.at(index);
+}
+
+SearchServer &ShardedSearchServer::GetShard(size_t index)
+{
+    return *shards_.at(index);
+}
+
+size_t ShardedSearchServer::GetShardIndex(int document_id) const
+{
+    // negative ids are never stored, any shard rejects them the way a single server does
+    return document_id >= 0 ? static_cast<size_t>(document_id) % shards_.size() : 0;
+}
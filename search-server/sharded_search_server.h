@@ -0,0 +1,170 @@
+#pragma once
+
+#include "search_server.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <execution>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// SearchServer split into shards by document id. A query runs on every shard with document
+// frequencies summed over all of them and the per-shard top documents are merged, so results
+// and relevance are the same as one SearchServer holding every document would give.
+class ShardedSearchServer
+{
+public:
+    template <typename StringContainer>
+    ShardedSearchServer(std::size_t shard_count, StringContainer stop_words);
+
+    ShardedSearchServer(std::size_t shard_count, std::string_view stop_words_text);
+
+    ShardedSearchServer(std::size_t shard_count, const std::string &stop_words_text);
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status,
+                     const std::vector<int> &ratings);
+
+    void RemoveDocument(int document_id);
+
+    // the shards are searched in parallel under std::execution::par, one by one otherwise
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy &policy, std::string_view raw_query,
+                                           DocumentPredicate document_predicate,
+                                           std::size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy &policy, std::string_view raw_query, DocumentStatus status,
+                                           std::size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy &policy, std::string_view raw_query) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query,
+                                           DocumentPredicate document_predicate,
+                                           std::size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                                           std::size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+    SearchServer::MatchTuple MatchDocument(std::string_view raw_query, int document_id) const;
+
+    SearchServer::WordFrequencies GetWordFrequencies(int document_id) const;
+
+    int GetDocumentCount() const;
+
+    std::size_t GetShardCount() const;
+
+    const SearchServer &GetShard(std::size_t index) const;
+
+    SearchServer &GetShard(std::size_t index);
+
+private:
+    std::vector<std::unique_ptr<SearchServer>> shards_;
+    // 0 to shard count, for std::for_each over the shards
+    std::vector<std::size_t> shard_indexes_;
+    // every word in the order a single SearchServer would have met it, stop words first;
+    // term ids are the ranks queries sum their words in
+    TermDictionary dictionary_;
+
+    std::size_t GetShardIndex(int document_id) const;
+
+    // frequencies are gathered from the shards under the policy and summed here
+    template <typename ExecutionPolicy>
+    CorpusStatistics GetCorpusStatistics(const ExecutionPolicy &policy, const QueryWords &query_words) const;
+};
+
+template <typename StringContainer>
+ShardedSearchServer::ShardedSearchServer(std::size_t shard_count, StringContainer stop_words)
+{
+    if (shard_count == 0)
+    {
+        throw std::invalid_argument("Sharded search server needs at least one shard");
+    }
+    for (std::size_t i = 0; i < shard_count; ++i)
+    {
+        shards_.push_back(std::make_unique<SearchServer>(stop_words));
+    }
+    shard_indexes_.resize(shard_count);
+    std::iota(shard_indexes_.begin(), shard_indexes_.end(), 0);
+    for (const std::string &word : MakeUniqueNonEmptyStrings(stop_words))
+    {
+        dictionary_.Intern(word);
+    }
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const ExecutionPolicy &policy, std::string_view raw_query,
+                                                            DocumentPredicate document_predicate, std::size_t max_count) const
+{
+    // parsed once for all shards, throws on an invalid query before any shard is asked
+    const QueryWords query_words = SearchServer::ParseQueryWords(raw_query);
+    const CorpusStatistics statistics = GetCorpusStatistics(policy, query_words);
+    std::vector<std::vector<Document>> shard_documents(shards_.size());
+    std::for_each(policy, shard_indexes_.begin(), shard_indexes_.end(), [&](std::size_t index)
+                  { shard_documents[index] = shards_[index]->FindTopDocumentsWithStatistics(
+                        std::execution::seq, query_words, statistics, document_predicate, max_count); });
+
+    TopDocumentsCollector top_documents(max_count);
+    for (const auto &documents : shard_documents)
+    {
+        for (const Document &document : documents)
+        {
+            top_documents.Add(document);
+        }
+    }
+    return top_documents.Extract();
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const ExecutionPolicy &policy, std::string_view raw_query,
+                                                            DocumentStatus status, std::size_t max_count) const
+{
+    return FindTopDocuments(
+        policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating)
+        { return document_status == status; },
+        max_count);
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const ExecutionPolicy &policy, std::string_view raw_query) const
+{
+    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query,
+                                                            DocumentPredicate document_predicate, std::size_t max_count) const
+{
+    return FindTopDocuments(std::execution::seq, raw_query, document_predicate, max_count);
+}
+
+template <typename ExecutionPolicy>
+CorpusStatistics ShardedSearchServer::GetCorpusStatistics(const ExecutionPolicy &policy, const QueryWords &query_words) const
+{
+    std::vector<std::vector<int>> shard_document_freqs(shards_.size());
+    std::for_each(policy, shard_indexes_.begin(), shard_indexes_.end(), [&](std::size_t index)
+                  { shard_document_freqs[index] = shards_[index]->GetWordDocumentFreqs(query_words); });
+
+    CorpusStatistics statistics;
+    statistics.words.resize(query_words.plus_words.size());
+    for (std::size_t i = 0; i < query_words.plus_words.size(); ++i)
+    {
+        statistics.words[i].rank = dictionary_.Find(query_words.plus_words[i]);
+    }
+    for (std::size_t index = 0; index < shards_.size(); ++index)
+    {
+        statistics.document_count += shards_[index]->GetDocumentCount();
+        for (std::size_t i = 0; i < statistics.words.size(); ++i)
+        {
+            statistics.words[i].document_freq += shard_document_freqs[index][i];
+        }
+    }
+    return statistics;
+}
@@ -0,0 +1,280 @@
+#include "snapshot.h"
+
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+    const char SNAPSHOT_MAGIC[8] = {'S', 'R', 'C', 'H', 'S', 'N', 'A', 'P'};
+
+    const uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+
+    const size_t WRITE_BUFFER_SIZE = 4 << 20;
+
+    uint64_t AlignUp(uint64_t offset)
+    {
+        return (offset + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT;
+    }
+
+    uint64_t GetPayloadBegin(size_t section_count)
+    {
+        return AlignUp(sizeof(SnapshotHeader) + section_count * sizeof(SnapshotSectionInfo));
+    }
+}
+
+uint64_t ComputeSnapshotChecksum(uint64_t checksum, const char *data, size_t size)
+{
+    // word-at-a-time multiply-xorshift mix; chunks fed in sequence must be multiples of 8 bytes
+    const uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        checksum = (checksum ^ word) * multiplier;
+        checksum ^= checksum >> 29;
+    }
+    for (; i < size; ++i)
+    {
+        checksum = (checksum ^ static_cast<unsigned char>(data[i])) * multiplier;
+    }
+    return checksum;
+}
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const string &path)
+{
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE)
+    {
+        throw runtime_error("Cannot open snapshot " + path);
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file_, &file_size) || file_size.QuadPart == 0)
+    {
+        CloseHandle(file_);
+        throw runtime_error("Cannot map snapshot " + path);
+    }
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void *view = mapping_ != nullptr ? MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (view == nullptr)
+    {
+        if (mapping_ != nullptr)
+        {
+            CloseHandle(mapping_);
+        }
+        CloseHandle(file_);
+        throw runtime_error("Cannot map snapshot " + path);
+    }
+    data_ = static_cast<const char *>(view);
+    size_ = static_cast<size_t>(file_size.QuadPart);
+}
+
+MappedFile::~MappedFile()
+{
+    UnmapViewOfFile(data_);
+    CloseHandle(mapping_);
+    CloseHandle(file_);
+}
+
+#else
+
+MappedFile::MappedFile(const string &path)
+{
+    const int descriptor = open(path.c_str(), O_RDONLY);
+    if (descriptor < 0)
+    {
+        throw runtime_error("Cannot open snapshot " + path);
+    }
+    struct stat file_stat;
+    if (fstat(descriptor, &file_stat) != 0 || file_stat.st_size == 0)
+    {
+        close(descriptor);
+        throw runtime_error("Cannot map snapshot " + path);
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    void *view = mmap(nullptr, size_, PROT_READ, MAP_SHARED, descriptor, 0);
+    // the mapping keeps the file alive, the descriptor is not needed anymore
+    close(descriptor);
+    if (view == MAP_FAILED)
+    {
+        throw runtime_error("Cannot map snapshot " + path);
+    }
+    data_ = static_cast<const char *>(view);
+}
+
+MappedFile::~MappedFile()
+{
+    munmap(const_cast<char *>(data_), size_);
+}
+
+#endif
+
+SnapshotWriter::SnapshotWriter(const string &path, size_t section_count)
+    : path_(path), temporary_path_(path + ".tmp"), out_(temporary_path_, ios::binary | ios::trunc), section_capacity_(section_count)
+{
+    if (!out_)
+    {
+        throw runtime_error("Cannot write snapshot " + path);
+    }
+    // header and section table are filled in by Finish()
+    const uint64_t payload_begin = GetPayloadBegin(section_count);
+    const vector<char> placeholder(payload_begin, 0);
+    out_.write(placeholder.data(), placeholder.size());
+    offset_ = payload_begin;
+    checksum_ = payload_begin;
+    pending_.reserve(WRITE_BUFFER_SIZE);
+}
+
+void SnapshotWriter::BeginSection(SnapshotSection kind)
+{
+    if (sections_.size() == section_capacity_)
+    {
+        throw logic_error("Snapshot section table is full");
+    }
+    if (!sections_.empty())
+    {
+        sections_.back().size = offset_ - sections_.back().offset;
+    }
+    Pad();
+    sections_.push_back({kind, 0, offset_, 0});
+}
+
+void SnapshotWriter::Write(const void *data, size_t size)
+{
+    const char *bytes = static_cast<const char *>(data);
+    pending_.insert(pending_.end(), bytes, bytes + size);
+    offset_ += size;
+    if (pending_.size() >= WRITE_BUFFER_SIZE)
+    {
+        Flush();
+    }
+}
+
+void SnapshotWriter::Finish()
+{
+    if (sections_.size() != section_capacity_)
+    {
+        throw logic_error("Snapshot section table is not filled");
+    }
+    if (!sections_.empty())
+    {
+        sections_.back().size = offset_ - sections_.back().offset;
+    }
+    Pad();
+    // Pad() leaves the payload 8-byte aligned, so the whole buffer can go
+    Flush();
+
+    SnapshotHeader header;
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byte_order = SNAPSHOT_BYTE_ORDER;
+    header.file_size = offset_;
+    header.checksum = ComputeSnapshotChecksum(checksum_, reinterpret_cast<const char *>(sections_.data()),
+                                              sections_.size() * sizeof(SnapshotSectionInfo));
+    header.section_count = static_cast<uint32_t>(sections_.size());
+    header.reserved = 0;
+    out_.seekp(0);
+    out_.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out_.write(reinterpret_cast<const char *>(sections_.data()), sections_.size() * sizeof(SnapshotSectionInfo));
+    out_.close();
+    if (!out_)
+    {
+        throw runtime_error("Cannot write snapshot " + path_);
+    }
+    filesystem::rename(temporary_path_, path_);
+}
+
+void SnapshotWriter::Pad()
+{
+    static const char zeros[SNAPSHOT_ALIGNMENT] = {};
+    const uint64_t aligned = AlignUp(offset_);
+    if (aligned != offset_)
+    {
+        Write(zeros, aligned - offset_);
+    }
+}
+
+void SnapshotWriter::Flush()
+{
+    // keep a tail shorter than a checksum word for the next flush
+    const size_t size = pending_.size() / sizeof(uint64_t) * sizeof(uint64_t);
+    checksum_ = ComputeSnapshotChecksum(checksum_, pending_.data(), size);
+    out_.write(pending_.data(), size);
+    if (!out_)
+    {
+        throw runtime_error("Cannot write snapshot " + path_);
+    }
+    pending_.erase(pending_.begin(), pending_.begin() + size);
+}
+
+SnapshotReader::SnapshotReader(const string &path)
+    : file_(make_shared<MappedFile>(path))
+{
+    const char *data = file_->data();
+    const size_t size = file_->size();
+    if (size < sizeof(SnapshotHeader))
+    {
+        ThrowCorrupted();
+    }
+    SnapshotHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 || header.byte_order != SNAPSHOT_BYTE_ORDER)
+    {
+        throw runtime_error("File " + path + " is not a search server snapshot");
+    }
+    if (header.version != SNAPSHOT_VERSION)
+    {
+        throw runtime_error("Unsupported snapshot version " + to_string(header.version));
+    }
+    const uint64_t payload_begin = GetPayloadBegin(header.section_count);
+    if (header.file_size != size || payload_begin > size)
+    {
+        ThrowCorrupted();
+    }
+    sections_ = reinterpret_cast<const SnapshotSectionInfo *>(data + sizeof(SnapshotHeader));
+    section_count_ = header.section_count;
+    uint64_t checksum = ComputeSnapshotChecksum(payload_begin, data + payload_begin, size - payload_begin);
+    checksum = ComputeSnapshotChecksum(checksum, reinterpret_cast<const char *>(sections_), section_count_ * sizeof(SnapshotSectionInfo));
+    if (checksum != header.checksum)
+    {
+        ThrowCorrupted();
+    }
+    for (size_t i = 0; i < section_count_; ++i)
+    {
+        if (sections_[i].offset % SNAPSHOT_ALIGNMENT != 0 || sections_[i].offset > size || sections_[i].size > size - sections_[i].offset)
+        {
+            ThrowCorrupted();
+        }
+    }
+}
+
+pair<const char *, size_t> SnapshotReader::GetSection(SnapshotSection kind) const
+{
+    for (size_t i = 0; i < section_count_; ++i)
+    {
+        if (sections_[i].kind == kind)
+        {
+            return {file_->data() + sections_[i].offset, sections_[i].size};
+        }
+    }
+    ThrowCorrupted();
+}
+
+void SnapshotReader::ThrowCorrupted()
+{
+    throw runtime_error("Snapshot is corrupted");
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// On-disk layout: SnapshotHeader, a table of SnapshotSectionInfo, then the
+// section payloads, each aligned to SNAPSHOT_ALIGNMENT. The checksum covers
+// everything after the header, so a truncated or damaged file is rejected.
+const std::uint32_t SNAPSHOT_VERSION = 1;
+
+const std::size_t SNAPSHOT_ALIGNMENT = 64;
+
+enum class SnapshotSection : std::uint32_t
+{
+    SERVER_META,
+    DICTIONARY_POOL,
+    DICTIONARY_WORDS,
+    DICTIONARY_HASHES,
+    DICTIONARY_SLOTS,
+    POSTING_LAYOUTS,
+    POSTING_BLOCKS,
+    POSTING_PACKED,
+    POSTING_TAILS,
+    TERM_MAX_FREQS,
+    DOCUMENTS,
+    DOCUMENT_TERMS,
+    DOCUMENT_IDS,
+};
+
+struct SnapshotHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint64_t file_size;
+    std::uint64_t checksum;
+    std::uint32_t section_count;
+    std::uint32_t reserved;
+};
+
+struct SnapshotSectionInfo
+{
+    SnapshotSection kind;
+    std::uint32_t reserved;
+    std::uint64_t offset;
+    std::uint64_t size;
+};
+
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string &path);
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile();
+
+    const char *data() const
+    {
+        return data_;
+    }
+
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+private:
+    const char *data_ = nullptr;
+    std::size_t size_ = 0;
+#ifdef _WIN32
+    void *file_ = nullptr;
+    void *mapping_ = nullptr;
+#endif
+};
+
+class SnapshotWriter
+{
+public:
+    // writes to a temporary file next to path, Finish() renames it into place
+    SnapshotWriter(const std::string &path, std::size_t section_count);
+
+    void BeginSection(SnapshotSection kind);
+
+    void Write(const void *data, std::size_t size);
+
+    template <typename T>
+    void WriteArray(const T *data, std::size_t count)
+    {
+        Write(data, count * sizeof(T));
+    }
+
+    void Finish();
+
+private:
+    std::string path_;
+    std::string temporary_path_;
+    std::ofstream out_;
+    std::vector<SnapshotSectionInfo> sections_;
+    std::size_t section_capacity_;
+    std::uint64_t offset_ = 0;
+    std::uint64_t checksum_;
+    std::vector<char> pending_;
+
+    void Pad();
+
+    void Flush();
+};
+
+class SnapshotReader
+{
+public:
+    // maps the file and validates magic, version, byte order and checksum
+    explicit SnapshotReader(const std::string &path);
+
+    template <typename T>
+    std::pair<const T *, std::size_t> GetArray(SnapshotSection kind) const
+    {
+        const auto [data, size] = GetSection(kind);
+        if (size % sizeof(T) != 0)
+        {
+            ThrowCorrupted();
+        }
+        return {reinterpret_cast<const T *>(data), size / sizeof(T)};
+    }
+
+    const std::shared_ptr<const MappedFile> &GetFile() const
+    {
+        return file_;
+    }
+
+private:
+    std::shared_ptr<const MappedFile> file_;
+    const SnapshotSectionInfo *sections_ = nullptr;
+    std::size_t section_count_ = 0;
+
+    std::pair<const char *, std::size_t> GetSection(SnapshotSection kind) const;
+
+    [[noreturn]] static void ThrowCorrupted();
+};
+
+std::uint64_t ComputeSnapshotChecksum(std::uint64_t checksum, const char *data, std::size_t size);
@@ -1,18 +1,221 @@
 #include "string_processing.h"
 
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define SEARCH_SERVER_HAS_AVX2_TOKENIZER
+#endif
+
 using namespace std;
 
-vector<string_view> SplitIntoWordsView(string_view str)
+namespace
 {
-    vector<string_view> result;
-    int64_t pos = str.find_first_not_of(" ");
-    const int64_t pos_end = str.npos;
-    while (pos != pos_end)
+    constexpr size_t BLOCK_SIZE = 64;
+
+    // bit i describes byte i of a 64-byte block
+    struct BlockMasks
+    {
+        uint64_t spaces;
+        uint64_t controls;
+    };
+
+    // bytes 0x00-0x1F are control characters, bytes above 0x7F belong to multibyte words
+    struct ScalarClassifier
+    {
+        static BlockMasks Classify(const char *block)
+        {
+            BlockMasks masks{0, 0};
+            for (size_t i = 0; i < BLOCK_SIZE; ++i)
+            {
+                const auto byte = static_cast<unsigned char>(block[i]);
+                masks.spaces |= static_cast<uint64_t>(byte == ' ') << i;
+                masks.controls |= static_cast<uint64_t>(byte < ' ') << i;
+            }
+            return masks;
+        }
+    };
+
+#ifdef __SSE2__
+    struct Sse2Classifier
+    {
+        static BlockMasks Classify(const char *block)
+        {
+            const __m128i space = _mm_set1_epi8(' ');
+            const __m128i last_control = _mm_set1_epi8(' ' - 1);
+            BlockMasks masks{0, 0};
+            for (size_t i = 0; i < BLOCK_SIZE; i += 16)
+            {
+                const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + i));
+                // unsigned byte <= 0x1F exactly when min(byte, 0x1F) == byte
+                const __m128i controls = _mm_cmpeq_epi8(_mm_min_epu8(bytes, last_control), bytes);
+                masks.spaces |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, space)))) << i;
+                masks.controls |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(controls))) << i;
+            }
+            return masks;
+        }
+    };
+#endif
+
+#ifdef SEARCH_SERVER_HAS_AVX2_TOKENIZER
+    struct Avx2Classifier
+    {
+        __attribute__((target("avx2"))) static BlockMasks Classify(const char *block)
+        {
+            const __m256i space = _mm256_set1_epi8(' ');
+            const __m256i last_control = _mm256_set1_epi8(' ' - 1);
+            BlockMasks masks{0, 0};
+            for (size_t i = 0; i < BLOCK_SIZE; i += 32)
+            {
+                const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + i));
+                const __m256i controls = _mm256_cmpeq_epi8(_mm256_min_epu8(bytes, last_control), bytes);
+                masks.spaces |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, space)))) << i;
+                masks.controls |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(controls))) << i;
+            }
+            return masks;
+        }
+    };
+#endif
+
+    int CountTrailingZeros(uint64_t value)
+    {
+#ifdef __GNUC__
+        return __builtin_ctzll(value);
+#else
+        int count = 0;
+        for (; (value & 1) == 0; value >>= 1)
+        {
+            ++count;
+        }
+        return count;
+#endif
+    }
+
+    // the last partial block is copied into a buffer padded with spaces, so it ends every open word
+    template <typename Classifier, typename Function>
+    void ForEachBlock(string_view text, Function function)
     {
-        int64_t space = str.find(' ', pos);
-        result.push_back(space == pos_end ? str.substr(pos) : str.substr(pos, space - pos));
-        pos = str.find_first_not_of(" ", space);
+        size_t offset = 0;
+        for (; offset + BLOCK_SIZE <= text.size(); offset += BLOCK_SIZE)
+        {
+            function(offset, Classifier::Classify(text.data() + offset));
+        }
+        if (offset < text.size())
+        {
+            char padded[BLOCK_SIZE];
+            fill(padded, padded + BLOCK_SIZE, ' ');
+            copy(text.begin() + offset, text.end(), padded);
+            function(offset, Classifier::Classify(padded));
+        }
     }
 
+    template <typename Classifier>
+    size_t SplitIntoWords(string_view text, vector<string_view> &words)
+    {
+        words.clear();
+        size_t first_control = text.size();
+        bool is_previous_space = true;
+        bool is_in_word = false;
+        size_t word_begin = 0;
+        ForEachBlock<Classifier>(text, [&](size_t offset, const BlockMasks &masks)
+                                 {
+                                     if (masks.controls != 0 && first_control == text.size())
+                                     {
+                                         first_control = offset + CountTrailingZeros(masks.controls);
+                                     }
+                                     // a word starts on a non-space after a space and ends on a space after a non-space
+                                     const uint64_t previous_spaces = (masks.spaces << 1) | static_cast<uint64_t>(is_previous_space);
+                                     for (uint64_t edges = masks.spaces ^ previous_spaces; edges != 0; edges &= edges - 1)
+                                     {
+                                         const size_t position = offset + CountTrailingZeros(edges);
+                                         if (is_in_word)
+                                         {
+                                             words.emplace_back(text.data() + word_begin, position - word_begin);
+                                         }
+                                         else
+                                         {
+                                             word_begin = position;
+                                         }
+                                         is_in_word = !is_in_word;
+                                     }
+                                     is_previous_space = (masks.spaces >> (BLOCK_SIZE - 1)) != 0; });
+        if (is_in_word)
+        {
+            words.push_back(text.substr(word_begin));
+        }
+        if (first_control == text.size())
+        {
+            return words.size();
+        }
+        // the control character is not a space, so it lies inside the last word starting at or before it
+        const auto it = upper_bound(words.begin(), words.end(), first_control, [&text](size_t position, string_view word)
+                                    { return position < static_cast<size_t>(word.data() - text.data()); });
+        return static_cast<size_t>(it - words.begin()) - 1;
+    }
+
+    template <typename Classifier>
+    bool HasControls(string_view text)
+    {
+        bool has_controls = false;
+        ForEachBlock<Classifier>(text, [&has_controls](size_t, const BlockMasks &masks)
+                                 { has_controls = has_controls || masks.controls != 0; });
+        return has_controls;
+    }
+
+    struct Tokenizer
+    {
+        const char *name;
+        size_t (*split)(string_view, vector<string_view> &);
+        bool (*has_controls)(string_view);
+    };
+
+    template <typename Classifier>
+    Tokenizer MakeTokenizer(const char *name)
+    {
+        return {name, SplitIntoWords<Classifier>, HasControls<Classifier>};
+    }
+
+    const Tokenizer &GetTokenizer()
+    {
+        static const Tokenizer tokenizer = []()
+        {
+#ifdef SEARCH_SERVER_HAS_AVX2_TOKENIZER
+            if (__builtin_cpu_supports("avx2"))
+            {
+                return MakeTokenizer<Avx2Classifier>("avx2");
+            }
+#endif
+#ifdef __SSE2__
+            return MakeTokenizer<Sse2Classifier>("sse2");
+#else
+            return MakeTokenizer<ScalarClassifier>("scalar");
+#endif
+        }();
+        return tokenizer;
+    }
+}
+
+vector<string_view> SplitIntoWordsView(string_view str)
+{
+    vector<string_view> result;
+    SplitIntoWordsView(str, result);
     return result;
-}
\ No newline at end of file
+}
+
+size_t SplitIntoWordsView(string_view text, vector<string_view> &words)
+{
+    return GetTokenizer().split(text, words);
+}
+
+bool HasControlCharacters(string_view text)
+{
+    return GetTokenizer().has_controls(text);
+}
+
+const char *GetTokenizerName()
+{
+    return GetTokenizer().name;
+}
@@ -4,10 +4,21 @@
 #include <string>
 #include <string_view>
 #include <set>
+#include <cstddef>
 #include <cstdint>
 
 std::vector<std::string_view> SplitIntoWordsView(std::string_view text);
 
+// Splits text on spaces into words, reusing the capacity of the buffer, and looks for control
+// characters in the same pass. Returns the index of the first word holding one, or
+// words.size() when the text is clean.
+std::size_t SplitIntoWordsView(std::string_view text, std::vector<std::string_view> &words);
+
+bool HasControlCharacters(std::string_view text);
+
+// implementation picked for this CPU: "avx2", "sse2" or "scalar"
+const char *GetTokenizerName();
+
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(StringContainer strings)
 {
@@ -0,0 +1,167 @@
+#include "term_dictionary.h"
+
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+TermDictionary::TermDictionary()
+{
+    slots_.Mutable().assign(MIN_SLOT_COUNT, NO_TERM);
+}
+
+TermDictionary::TermId TermDictionary::Intern(string_view word)
+{
+    const uint64_t hash = ComputeHash(word);
+    size_t slot = FindSlot(word, hash);
+    if (slots_[slot] != NO_TERM)
+    {
+        return slots_[slot];
+    }
+    // keep load factor at most 1/2 so probe sequences stay short
+    if ((words_.size() + 1) * 2 > slots_.size())
+    {
+        Rehash(slots_.size() * 2);
+        slot = FindSlot(word, hash);
+    }
+    const TermId term = static_cast<TermId>(words_.size());
+    words_.Mutable().push_back(CopyToArena(word));
+    hashes_.Mutable().push_back(hash);
+    slots_.Mutable()[slot] = term;
+    return term;
+}
+
+TermDictionary::TermId TermDictionary::Find(string_view word) const
+{
+    return slots_[FindSlot(word, ComputeHash(word))];
+}
+
+size_t TermDictionary::GetSize() const
+{
+    return words_.size();
+}
+
+size_t TermDictionary::GetMemoryUsage() const
+{
+    return owned_bytes_ + chunks_.capacity() * sizeof(const char *) + words_.GetMemoryUsage() + hashes_.GetMemoryUsage() + slots_.GetMemoryUsage();
+}
+
+void TermDictionary::SaveSnapshot(SnapshotWriter &writer) const
+{
+    // all words go into one pool, so their locations are rebased onto chunk 0
+    vector<WordLocation> locations;
+    locations.reserve(words_.size());
+    uint64_t offset = 0;
+    writer.BeginSection(SnapshotSection::DICTIONARY_POOL);
+    for (TermId term = 0; term < words_.size(); ++term)
+    {
+        const string_view word = GetWord(term);
+        if (offset + word.size() > numeric_limits<uint32_t>::max())
+        {
+            throw runtime_error("Dictionary is too large for a snapshot");
+        }
+        writer.Write(word.data(), word.size());
+        locations.push_back({0, static_cast<uint32_t>(offset), static_cast<uint32_t>(word.size())});
+        offset += word.size();
+    }
+    writer.BeginSection(SnapshotSection::DICTIONARY_WORDS);
+    writer.WriteArray(locations.data(), locations.size());
+    writer.BeginSection(SnapshotSection::DICTIONARY_HASHES);
+    writer.WriteArray(hashes_.data(), hashes_.size());
+    writer.BeginSection(SnapshotSection::DICTIONARY_SLOTS);
+    writer.WriteArray(slots_.data(), slots_.size());
+}
+
+void TermDictionary::LoadSnapshot(const SnapshotReader &reader)
+{
+    const auto [pool, pool_size] = reader.GetArray<char>(SnapshotSection::DICTIONARY_POOL);
+    const auto [words, word_count] = reader.GetArray<WordLocation>(SnapshotSection::DICTIONARY_WORDS);
+    const auto [hashes, hash_count] = reader.GetArray<uint64_t>(SnapshotSection::DICTIONARY_HASHES);
+    const auto [slots, slot_count] = reader.GetArray<TermId>(SnapshotSection::DICTIONARY_SLOTS);
+    bool is_valid = hash_count == word_count && slot_count >= MIN_SLOT_COUNT && (slot_count & (slot_count - 1)) == 0 && word_count * 2 <= slot_count;
+    for (size_t term = 0; is_valid && term < word_count; ++term)
+    {
+        is_valid = words[term].chunk == 0 && static_cast<size_t>(words[term].offset) + words[term].size <= pool_size;
+    }
+    for (size_t slot = 0; is_valid && slot < slot_count; ++slot)
+    {
+        is_valid = slots[slot] == NO_TERM || slots[slot] < word_count;
+    }
+    if (!is_valid)
+    {
+        throw runtime_error("Snapshot dictionary is corrupted");
+    }
+    chunks_.assign(1, pool);
+    owned_chunks_.clear();
+    owned_bytes_ = 0;
+    // the mapped pool is read-only, new words start a fresh arena chunk
+    arena_chunk_used_ = ARENA_CHUNK_SIZE;
+    words_ = MappedArray<WordLocation>(words, word_count);
+    hashes_ = MappedArray<uint64_t>(hashes, hash_count);
+    slots_ = MappedArray<TermId>(slots, slot_count);
+}
+
+uint64_t TermDictionary::ComputeHash(string_view word)
+{
+    // FNV-1a, stable across platforms and runs
+    uint64_t hash = 14695981039346656037ull;
+    for (const char c : word)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+size_t TermDictionary::FindSlot(string_view word, uint64_t hash) const
+{
+    const size_t mask = slots_.size() - 1;
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask)
+    {
+        const TermId term = slots_[slot];
+        if (term == NO_TERM || (hashes_[term] == hash && GetWord(term) == word))
+        {
+            return slot;
+        }
+    }
+}
+
+TermDictionary::WordLocation TermDictionary::CopyToArena(string_view word)
+{
+    if (word.size() > ARENA_CHUNK_SIZE / 4)
+    {
+        // long words get a dedicated chunk instead of wasting an arena tail
+        auto &storage = owned_chunks_.emplace_back(new char[word.size()]);
+        memcpy(storage.get(), word.data(), word.size());
+        owned_bytes_ += word.size();
+        chunks_.push_back(storage.get());
+        return {static_cast<uint32_t>(chunks_.size() - 1), 0, static_cast<uint32_t>(word.size())};
+    }
+    if (arena_chunk_used_ + word.size() > ARENA_CHUNK_SIZE)
+    {
+        chunks_.push_back(owned_chunks_.emplace_back(new char[ARENA_CHUNK_SIZE]).get());
+        owned_bytes_ += ARENA_CHUNK_SIZE;
+        arena_chunk_ = chunks_.size() - 1;
+        arena_chunk_used_ = 0;
+    }
+    memcpy(const_cast<char *>(chunks_[arena_chunk_]) + arena_chunk_used_, word.data(), word.size());
+    const WordLocation location{static_cast<uint32_t>(arena_chunk_), static_cast<uint32_t>(arena_chunk_used_), static_cast<uint32_t>(word.size())};
+    arena_chunk_used_ += word.size();
+    return location;
+}
+
+void TermDictionary::Rehash(size_t slot_count)
+{
+    vector<TermId> &slots = slots_.Mutable();
+    slots.assign(slot_count, NO_TERM);
+    const size_t mask = slot_count - 1;
+    for (TermId term = 0; term < words_.size(); ++term)
+    {
+        size_t slot = hashes_[term] & mask;
+        while (slots[slot] != NO_TERM)
+        {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = term;
+    }
+}
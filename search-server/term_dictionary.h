@@ -0,0 +1,71 @@
+#pragma once
+
+#include "mapped_array.h"
+#include "snapshot.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+class TermDictionary
+{
+public:
+    using TermId = std::uint32_t;
+
+    static constexpr TermId NO_TERM = std::numeric_limits<TermId>::max();
+
+    TermDictionary();
+
+    TermId Intern(std::string_view word);
+
+    TermId Find(std::string_view word) const;
+
+    std::string_view GetWord(TermId term) const
+    {
+        const WordLocation &location = words_[term];
+        return {chunks_[location.chunk] + location.offset, location.size};
+    }
+
+    std::size_t GetSize() const;
+
+    std::size_t GetMemoryUsage() const;
+
+    void SaveSnapshot(SnapshotWriter &writer) const;
+
+    // words, hashes and slots are served from the mapped file until the first Intern of a new word
+    void LoadSnapshot(const SnapshotReader &reader);
+
+private:
+    static constexpr std::size_t ARENA_CHUNK_SIZE = 64 * 1024;
+
+    static constexpr std::size_t MIN_SLOT_COUNT = 64;
+
+    struct WordLocation
+    {
+        std::uint32_t chunk;
+        std::uint32_t offset;
+        std::uint32_t size;
+    };
+
+    // base pointers of owned arena chunks and of a mapped snapshot pool
+    std::vector<const char *> chunks_;
+    std::vector<std::unique_ptr<char[]>> owned_chunks_;
+    std::size_t owned_bytes_ = 0;
+    std::size_t arena_chunk_ = 0;
+    std::size_t arena_chunk_used_ = ARENA_CHUNK_SIZE;
+
+    MappedArray<WordLocation> words_;
+    MappedArray<std::uint64_t> hashes_;
+    MappedArray<TermId> slots_;
+
+    static std::uint64_t ComputeHash(std::string_view word);
+
+    std::size_t FindSlot(std::string_view word, std::uint64_t hash) const;
+
+    WordLocation CopyToArena(std::string_view word);
+
+    void Rehash(std::size_t slot_count);
+};
@@ -0,0 +1,112 @@
+#include "thread_pool.h"
+
+#include <stdexcept>
+
+using namespace std;
+
+namespace
+{
+    // set in worker threads only
+    thread_local const ThreadPool *current_pool = nullptr;
+    thread_local size_t current_queue_index = 0;
+}
+
+ThreadPool::ThreadPool(size_t thread_count)
+{
+    if (thread_count == 0)
+    {
+        throw invalid_argument("Thread pool needs at least one thread");
+    }
+    for (size_t i = 0; i <= thread_count; ++i)
+    {
+        queues_.push_back(make_unique<TaskQueue>());
+    }
+    for (size_t i = 0; i < thread_count; ++i)
+    {
+        threads_.emplace_back([this, i]()
+                              { RunWorker(i); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard guard(sleep_mutex_);
+        is_stopping_ = true;
+    }
+    has_tasks_.notify_all();
+    for (thread &thread : threads_)
+    {
+        thread.join();
+    }
+}
+
+size_t ThreadPool::GetQueueIndex() const
+{
+    return current_pool == this ? current_queue_index : threads_.size();
+}
+
+void ThreadPool::Push(size_t queue_index, Task task)
+{
+    {
+        lock_guard guard(queues_[queue_index]->mutex);
+        queues_[queue_index]->tasks.push_back(move(task));
+    }
+    queued_count_.fetch_add(1);
+    // taking the mutex orders the count before the check of a worker about to sleep
+    {
+        lock_guard guard(sleep_mutex_);
+    }
+    has_tasks_.notify_one();
+}
+
+bool ThreadPool::TryRunTask(size_t queue_index)
+{
+    Task task;
+    {
+        TaskQueue &queue = *queues_[queue_index];
+        lock_guard guard(queue.mutex);
+        if (!queue.tasks.empty())
+        {
+            task = move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+    }
+    for (size_t i = 1; !task && i < queues_.size(); ++i)
+    {
+        TaskQueue &queue = *queues_[(queue_index + i) % queues_.size()];
+        lock_guard guard(queue.mutex);
+        if (!queue.tasks.empty())
+        {
+            task = move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+    }
+    if (!task)
+    {
+        return false;
+    }
+    queued_count_.fetch_sub(1);
+    task();
+    return true;
+}
+
+void ThreadPool::RunWorker(size_t index)
+{
+    current_pool = this;
+    current_queue_index = index;
+    while (true)
+    {
+        if (TryRunTask(index))
+        {
+            continue;
+        }
+        unique_lock lock(sleep_mutex_);
+        has_tasks_.wait(lock, [this]()
+                        { return is_stopping_ || queued_count_.load() > 0; });
+        if (is_stopping_)
+        {
+            return;
+        }
+    }
+}
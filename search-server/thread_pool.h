@@ -0,0 +1,113 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool. Every worker has its own deque: it takes its newest task from the back
+// and idle workers steal the oldest ones from the front. Threads outside the pool queue their
+// tasks in one shared deque. ParallelFor may be called from inside a task: the caller runs
+// tasks while it waits, so nested loops share the pool's threads and none of them blocks.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(std::size_t thread_count);
+
+    ThreadPool(const ThreadPool &) = delete;
+
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool();
+
+    std::size_t GetThreadCount() const
+    {
+        return threads_.size();
+    }
+
+    // calls function(begin, end) for chunks of at most grain_size indexes covering [0, count)
+    // and returns when all are done; the first exception thrown by a chunk is rethrown
+    template <typename Function>
+    void ParallelFor(std::size_t count, std::size_t grain_size, Function function);
+
+private:
+    using Task = std::function<void()>;
+
+    struct TaskQueue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    // one per worker, the last one is for threads outside the pool
+    std::vector<std::unique_ptr<TaskQueue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<std::size_t> queued_count_ = 0;
+    std::mutex sleep_mutex_;
+    std::condition_variable has_tasks_;
+    bool is_stopping_ = false;
+
+    // the queue of the calling thread: its own in a worker, the shared one elsewhere
+    std::size_t GetQueueIndex() const;
+
+    void Push(std::size_t queue_index, Task task);
+
+    // runs one task, from the given queue first and stolen from the others otherwise
+    bool TryRunTask(std::size_t queue_index);
+
+    void RunWorker(std::size_t index);
+};
+
+template <typename Function>
+void ThreadPool::ParallelFor(std::size_t count, std::size_t grain_size, Function function)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    grain_size = std::max<std::size_t>(grain_size, 1);
+    const std::size_t chunk_count = (count + grain_size - 1) / grain_size;
+    std::atomic<std::size_t> remaining_count = chunk_count;
+    std::mutex error_mutex;
+    std::exception_ptr error;
+
+    const std::size_t queue_index = GetQueueIndex();
+    for (std::size_t chunk = 0; chunk < chunk_count; ++chunk)
+    {
+        Push(queue_index, [&, chunk]()
+             {
+                 const std::size_t begin = chunk * grain_size;
+                 try
+                 {
+                     function(begin, std::min(count, begin + grain_size));
+                 }
+                 catch (...)
+                 {
+                     std::lock_guard guard(error_mutex);
+                     if (!error)
+                     {
+                         error = std::current_exception();
+                     }
+                 }
+                 // last touch of the caller's frame, it may return right after
+                 remaining_count.fetch_sub(1, std::memory_order_release); });
+    }
+    while (remaining_count.load(std::memory_order_acquire) > 0)
+    {
+        if (!TryRunTask(queue_index))
+        {
+            std::this_thread::yield();
+        }
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
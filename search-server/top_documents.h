@@ -0,0 +1,85 @@
+#pragma once
+
+#include "document.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+const double EPSILON = 1e-6;
+
+// relevance first, rating breaks near-ties, id makes the order total
+inline bool IsMoreRelevant(const Document &lhs, const Document &rhs)
+{
+    if (std::abs(lhs.relevance - rhs.relevance) < EPSILON)
+    {
+        if (lhs.rating != rhs.rating)
+        {
+            return lhs.rating > rhs.rating;
+        }
+        return lhs.id < rhs.id;
+    }
+    return lhs.relevance > rhs.relevance;
+}
+
+class TopDocumentsCollector
+{
+public:
+    explicit TopDocumentsCollector(std::size_t max_count)
+        : max_count_(max_count)
+    {
+        heap_.reserve(max_count);
+    }
+
+    void Add(const Document &document)
+    {
+        // heap_ is a max-heap under IsMoreRelevant, so front() is the least relevant kept document
+        if (heap_.size() < max_count_)
+        {
+            heap_.push_back(document);
+            std::push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+        }
+        else if (max_count_ > 0 && IsMoreRelevant(document, heap_.front()))
+        {
+            std::pop_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+            heap_.back() = document;
+            std::push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+        }
+    }
+
+    void Merge(const TopDocumentsCollector &other)
+    {
+        for (const Document &document : other.heap_)
+        {
+            Add(document);
+        }
+    }
+
+    std::size_t GetMaxCount() const
+    {
+        return max_count_;
+    }
+
+    bool IsFull() const
+    {
+        return heap_.size() >= max_count_;
+    }
+
+    // the document a newcomer has to beat once the collector is full
+    const Document &GetLeastRelevant() const
+    {
+        return heap_.front();
+    }
+
+    std::vector<Document> Extract()
+    {
+        std::sort_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+        return std::move(heap_);
+    }
+
+private:
+    std::size_t max_count_;
+    std::vector<Document> heap_;
+};